@@ -1,8 +0,0 @@
-
-#pragma once
-#include "pebble.h"
-
-#define SQRT_SCALE 65536
-#define SQRT_SHIFT 16
-
-uint32_t usqrt(uint32_t x);
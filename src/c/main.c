@@ -2,13 +2,13 @@
 #include <pebble.h>
 #include <pebble-events/pebble-events.h>
 #include "pebble-app-ready-service.h"
-#include "isqrt.h"
 
 // --------------------------------------------------------------------------
 // Constants
 // --------------------------------------------------------------------------
 
 /* Various useful time intervals expressed in seconds. */
+const time_t kOneMinute  = 60;
 const time_t kOneHour    = 60 * 60;
 const time_t kOneDay     = 60 * 60 * 24;
 
@@ -16,12 +16,25 @@ const time_t kOneDay     = 60 * 60 * 24;
 // Globals
 // --------------------------------------------------------------------------
 
+/* The forecast is a fixed capacity ring buffer, in hour order.  Entry hours
+   are kept relative to a base hour that stays put while the summary ages, so
+   expiring the first entry is just a matter of advancing the head. */
+enum { kForecastCapacity = 7 * 24 };
+
+typedef struct ForecastEntry {
+    uint16_t hour_offset; // hours after the forecast base_hour.
+    uint16_t count;
+} ForecastEntry;
+
 typedef struct StudySummary {
     uint16_t lesson_count;
     uint16_t review_count;
-    int32_t epoch_hour;
-    int32_t forecast_length;
-    uint8_t* forecast;
+    int32_t epoch_hour; // the hour that the counts are current for.
+    int32_t fetched_at; // when the phone fetched the counts from WaniKani.
+    int32_t base_hour;
+    int16_t forecast_head;
+    int16_t forecast_length; // number of entries.
+    ForecastEntry forecast[kForecastCapacity];
 } StudySummary;
 
 Window* s_main_screen;
@@ -30,49 +43,136 @@ Window* s_message_screen;
 StudySummary s_summary;
 AppTimer* s_refresh_timer;
 
-static char s_scratch_text_buffer[64];
+static inline const ForecastEntry* forecast_entry(const StudySummary* q, int k) {
+    return &q->forecast[(q->forecast_head + k) % kForecastCapacity];
+}
+
+/* The epoch hour of the k-th entry of the forecast. */
+static inline int32_t forecast_hour(const StudySummary* q, int k) {
+    return q->base_hour + forecast_entry(q, k)->hour_offset;
+}
+
+static void forecast_clear(StudySummary* q) {
+    q->base_hour = q->epoch_hour;
+    q->forecast_head = 0;
+    q->forecast_length = 0;
+}
+
+static bool forecast_push(StudySummary* q, int32_t hour, uint16_t count) {
+    if (q->forecast_length == kForecastCapacity || hour < q->base_hour || hour - q->base_hour > UINT16_MAX) {
+        return false;
+    }
+    int k = (q->forecast_head + q->forecast_length) % kForecastCapacity;
+    q->forecast[k].hour_offset = hour - q->base_hour;
+    q->forecast[k].count = count;
+    q->forecast_length += 1;
+    return true;
+}
+
 static char s_loading_text_buffer[128];
 static char s_message_text_buffer[128];
 static GColor s_message_fill_color;
 static GColor s_message_text_color;
 static AppLaunchReason s_launch_reason;
 static EventHandle s_app_message_event_handle;
+static bool s_first_success_logged;
+static bool s_diagnostics_pending;
+
+/* How long, in minutes, a fetched summary is fresh enough that opening the
+   app from one of its pins need not refresh it.  Zero means always refresh.
+   It is set in the phone settings and arrives with the summary. */
+static uint16_t s_freshness_ttl;
+static bool s_refresh_deferred;
+
+/* AppMessage buffers are allocated from the app heap, which is very small on
+   aplite.  The phone is told the forecast chunk size in the REFRESH message,
+   and splits the forecast to fit. */
+#if defined(PBL_PLATFORM_APLITE)
+static const uint16_t kForecastChunkSize = 128;
+#else
+static const uint16_t kForecastChunkSize = 512;
+#endif
+
+// --------------------------------------------------------------------------
+// Performance Counters
+// --------------------------------------------------------------------------
+
+/* Counters for where the time goes on a real watch.  They are sent to the
+   phone in a DIAGNOSTICS message after each SUCCESS, once the outbox is
+   free, as the raw bytes of this struct (little-endian uint32 values, in
+   this order), and can be shown over the main screen with a long press of
+   SELECT. */
+typedef struct PerfCounters {
+    uint32_t redraw_count;
+    uint32_t redraw_ms_total;
+    uint32_t redraw_ms_max;
+    uint32_t launch_to_refresh_ms;
+    uint32_t refresh_to_success_ms;
+    uint32_t inbox_bytes;
+    uint32_t heap_free_min;
+} PerfCounters;
+
+static PerfCounters s_perf;
+static int64_t s_launch_ms;
+static int64_t s_refresh_ms;
+static int64_t s_redraw_start_ms;
+
+static int64_t now_ms() {
+    time_t seconds;
+    uint16_t millis;
+    time_ms(&seconds, &millis);
+    return (int64_t)seconds * 1000 + millis;
+}
+
+static void perf_sample_heap() {
+    uint32_t heap_free = heap_bytes_free();
+    if (s_perf.heap_free_min == 0 || heap_free < s_perf.heap_free_min) {
+        s_perf.heap_free_min = heap_free;
+    }
+}
+
+static void perf_redraw_begin() {
+    s_redraw_start_ms = now_ms();
+}
+
+static void perf_redraw_end() {
+    uint32_t elapsed = now_ms() - s_redraw_start_ms;
+    s_perf.redraw_count += 1;
+    s_perf.redraw_ms_total += elapsed;
+    if (elapsed > s_perf.redraw_ms_max) {
+        s_perf.redraw_ms_max = elapsed;
+    }
+    perf_sample_heap();
+}
 
 // --------------------------------------------------------------------------
 // Fonts, Text, Colors, and Layout
 // --------------------------------------------------------------------------
 
+/* System fonts are looked up on first use, so only the fonts that are
+   actually drawn with are ever resolved. */
 typedef struct MFont {
+    const char* key;
     GFont gfont;
     uint8_t ascender; // from top of em-box to baseline.
     uint8_t cap_height; // from top of capitals to baseline.
 } MFont;
 
-MFont s_gothic_14r;
-MFont s_gothic_14b;
-MFont s_gothic_18r;
-MFont s_gothic_18b;
-MFont s_gothic_24r;
-MFont s_gothic_24b;
-MFont s_gothic_28r;
-MFont s_gothic_28b;
+MFont s_gothic_14r = { FONT_KEY_GOTHIC_14,      NULL, 5, 9 };
+MFont s_gothic_14b = { FONT_KEY_GOTHIC_14_BOLD, NULL, 5, 9 };
+MFont s_gothic_18r = { FONT_KEY_GOTHIC_18,      NULL, 7, 11 };
+MFont s_gothic_18b = { FONT_KEY_GOTHIC_18_BOLD, NULL, 7, 11 };
+MFont s_gothic_28b = { FONT_KEY_GOTHIC_28_BOLD, NULL, 10, 18 };
 GTextAttributes* s_layout_attributes = NULL;
 
-static void init_font(MFont* font, const char* key, uint16_t ascender, uint16_t cap_height) {
-    font->gfont = fonts_get_system_font(key);
-    font->ascender = ascender;
-    font->cap_height = cap_height;
-}
-
-static void init_fonts() {
-    init_font(&s_gothic_14r, FONT_KEY_GOTHIC_14,      5, 9);
-    init_font(&s_gothic_14b, FONT_KEY_GOTHIC_14_BOLD, 5, 9);
-    init_font(&s_gothic_18r, FONT_KEY_GOTHIC_18,      7, 11);
-    init_font(&s_gothic_18b, FONT_KEY_GOTHIC_18_BOLD, 7, 11);
-    init_font(&s_gothic_24r, FONT_KEY_GOTHIC_24,      10, 14);
-    init_font(&s_gothic_24b, FONT_KEY_GOTHIC_24_BOLD, 10, 14);
-    init_font(&s_gothic_28r, FONT_KEY_GOTHIC_28,      10, 18);
-    init_font(&s_gothic_28b, FONT_KEY_GOTHIC_28_BOLD, 10, 18);
+static GFont mfont_gfont(MFont* font) {
+    if (!font->gfont) {
+        font->gfont = fonts_get_system_font(font->key);
+    }
+    return font->gfont;
+}
+
+static void init_text_attributes() {
     s_layout_attributes = graphics_text_attributes_create();
     graphics_text_attributes_enable_screen_text_flow(s_layout_attributes, 10);
 }
@@ -85,25 +185,35 @@ static const GColor kLabelInsetColor   = {.argb = PBL_IF_COLOR_ELSE(GColorWhiteA
 static const GColor kLabelTextColor    = {.argb = PBL_IF_COLOR_ELSE(GColorBlackARGB8,          GColorBlackARGB8)};
 static const GColor kForecastBoxColor  = {.argb = PBL_IF_COLOR_ELSE(GColorWhiteARGB8,          GColorWhiteARGB8)};
 static const GColor kForecastTextColor = {.argb = PBL_IF_COLOR_ELSE(GColorBlackARGB8,          GColorBlackARGB8)};
+static const GColor kHistogramBarColor = {.argb = PBL_IF_COLOR_ELSE(GColorVividCeruleanARGB8,  GColorBlackARGB8)};
 static const GColor kErrorScreenColor  = {.argb = PBL_IF_COLOR_ELSE(GColorFollyARGB8,          GColorWhiteARGB8)};
 static const GColor kErrorTextColor    = {.argb = PBL_IF_COLOR_ELSE(GColorWhiteARGB8,          GColorBlackARGB8)};
 static const GColor kConfigScreenColor = {.argb = PBL_IF_COLOR_ELSE(GColorBlueARGB8,           GColorWhiteARGB8)};
 static const GColor kConfigTextColor   = {.argb = PBL_IF_COLOR_ELSE(GColorWhiteARGB8,          GColorBlackARGB8)};
+static const GColor kOfflineColor      = {.argb = PBL_IF_COLOR_ELSE(GColorFollyARGB8,          GColorBlackARGB8)};
+static const GColor kOfflineTextColor  = {.argb = PBL_IF_COLOR_ELSE(GColorWhiteARGB8,          GColorWhiteARGB8)};
 static const int16_t kBoxCornerRadius = 5;
 static const int16_t kBoxStrokeWidth  = 2;
 static const int16_t kBoxSpacing = 2;
-static const MFont* kLoadScreenFont = &s_gothic_18b;
-static const MFont* kMessageScreenFont = &s_gothic_18b;
-static const MFont* kValueFont = &s_gothic_28b;
-static const MFont* kLabelFont = &s_gothic_14r;
-static const MFont* kForecastHeadingFont = &s_gothic_14b;
-static const MFont* kForecastRowFont = &s_gothic_18r;
-static const MFont* kEmptyForecastFont = &s_gothic_18b;
+static MFont* const kLoadScreenFont = &s_gothic_18b;
+static MFont* const kMessageScreenFont = &s_gothic_18b;
+static MFont* const kValueFont = &s_gothic_28b;
+static MFont* const kLabelFont = &s_gothic_14r;
+static MFont* const kForecastHeadingFont = &s_gothic_14b;
+static MFont* const kForecastRowFont = &s_gothic_18r;
+static MFont* const kEmptyForecastFont = &s_gothic_18b;
+static MFont* const kPerfOverlayFont = &s_gothic_14r;
+static MFont* const kHistogramLabelFont = &s_gothic_14r;
+static MFont* const kOfflineFont = &s_gothic_14b;
 static const char const* kLoadScreenDefaultText = "TabiTabi";
 static const char const* kLessonsLabelText = "Lessons";
 static const char const* kReviewsLabelText = "Reviews";
 static const char const* kDayLabel[] = { "Today", "Tomorrow" };
 static const char const* kEmptyForecastText = "No reviews in your 24 hour forecast.";
+static const char const* kHistogramHeadingFormat = "Next 24 hours, peak %u";
+static const char const* kStagesHeadingFormat = "Level %u: %u/%u";
+static const char const* kOfflineText = "Offline";
+static const char const* kSrsStageLabel[] = { "Apprentice", "Guru", "Master", "Enlightened", "Burned" };
 
 static const GEdgeInsets kTextScreenInsets = {
     .top = 10, .left = 10, .right = 10
@@ -121,6 +231,8 @@ typedef struct AvailablesLayout {
     GCornerMask corner_mask;
     GColor color;
     const char* label;
+    char value_text[8];
+    Layer* layer;
 } AvailablesLayout;
 
 static GRect s_availables_box;
@@ -129,18 +241,139 @@ static TextFitment s_label_fitment;
 static AvailablesLayout s_lessons_layout;
 static AvailablesLayout s_reviews_layout;
 static GRect s_forecast_box;
+static Layer* s_forecast_layer;
+static Layer* s_perf_layer;
+static Layer* s_offline_layer;
+static GRect s_offline_box;
+static TextFitment s_offline_fitment;
+static bool s_offline; // the phone did not answer, so the summary may be stale.
 static GEdgeInsets s_forecast_insets;
 static int16_t s_time_col_w;
 static int16_t s_count_col_w;
 static int16_t s_total_col_w;
 
+/* Forecast rows are formatted once, whenever the summary changes or the
+   forecast is scrolled, so that a redraw only has to blit the cached strings.
+   Only the rows from the first one in view, and only as many as could
+   possibly fit on the display, are kept. */
+enum { kForecastCacheRows = 12 };
+
+typedef struct ForecastRow {
+    char heading[16]; // empty unless this row starts a new day.
+    char label_text[12]; // the time, or the name of an SRS stage.
+    char count_text[8];
+    char total_text[8];
+} ForecastRow;
+
+static ForecastRow s_forecast_rows[kForecastCacheRows];
+static int s_forecast_row_count;
+static bool s_forecast_clock_24h;
+static int s_forecast_scroll; // forecast index of the first row in view.
+static int s_forecast_rows_drawn; // number of rows that fit at the last redraw.
+
+/* SELECT cycles the forecast box through its views.  The SRS stages view is
+   skipped unless the phone has sent the study progress. */
+typedef enum ForecastView {
+    kForecastViewRows,
+    kForecastViewHistogram,
+    kForecastViewStages,
+    kForecastViewCount
+} ForecastView;
+
+static ForecastView s_forecast_view;
+
+/* The histogram view shows the review count for each hour of the next day,
+   in place of the forecast rows.  It is drawn only when the bars change, and
+   captured from the frame buffer into a bitmap that later redraws just blit. */
+enum { kHistogramHours = 24 };
+
+typedef struct Histogram {
+    int32_t base_hour; // the hour before the first bar.
+    bool clock_24h;
+    uint16_t bars[kHistogramHours];
+} Histogram;
+
+static Histogram s_histogram;
+static GBitmap* s_histogram_bitmap;
+static bool s_histogram_captured; // the bitmap holds the current histogram.
+
+/* The frame buffer only holds the histogram where the layer says it is once
+   the main screen is on top and its transition has finished, so it is not
+   captured until a little after the screen appears. */
+static const uint32_t kMainScreenSettleMs = 500;
+static AppTimer* s_main_screen_settle_timer;
+static bool s_main_screen_settled;
+
+#if defined(PBL_ROUND)
+/* The narrowest bars that the histogram is drawn with on the round display,
+   where the chart is raised off the bottom of the circle to make room. */
+static const int16_t kRoundMinBarWidth = 4;
+#endif
+
+/* The study progress comes from the optional assignments sync on the phone:
+   the number of items in each group of SRS stages, and the kanji passed on
+   the current level.  Its rows are formatted when it arrives. */
+enum { kSrsStageGroups = 5 };
+
+typedef struct StudyProgress {
+    uint8_t level; // zero if there is no progress to show.
+    uint8_t level_passed;
+    uint8_t level_total;
+    uint16_t stage_counts[kSrsStageGroups];
+} StudyProgress;
+
+static StudyProgress s_progress;
+static ForecastRow s_stage_rows[kSrsStageGroups];
+
+#if defined(PBL_ROUND)
+/* Half the width of the round display at each distance from its center
+   line, floor(sqrt(88^2 - dy^2)) for dy = 0..90, and zero past 88.  We use a
+   radius that is a little reduced from the raw display size in order to
+   accomodate the overlap of the bezel.  The table is generated by
+
+     python3 -c 'import math; print([math.isqrt(max(88*88 - dy*dy, 0)) for dy in range(91)])'
+
+   and checked against an integer square root by the host tests. */
+static const int16_t kRoundCenter = 90;
+static const uint8_t kRoundHalfWidth[] = {
+     88,  87,  87,  87,  87,  87,  87,  87,  87,  87,  87,  87,
+     87,  87,  86,  86,  86,  86,  86,  85,  85,  85,  85,  84,
+     84,  84,  84,  83,  83,  83,  82,  82,  81,  81,  81,  80,
+     80,  79,  79,  78,  78,  77,  77,  76,  76,  75,  75,  74,
+     73,  73,  72,  71,  70,  70,  69,  68,  67,  67,  66,  65,
+     64,  63,  62,  61,  60,  59,  58,  57,  55,  54,  53,  51,
+     50,  49,  47,  46,  44,  42,  40,  38,  36,  34,  31,  29,
+     26,  22,  18,  13,   0,   0,   0,
+};
+
+static int16_t round_half_width(int16_t y) {
+    int16_t dy = y < kRoundCenter ? kRoundCenter - y : y - kRoundCenter;
+    return dy < (int16_t)ARRAY_LENGTH(kRoundHalfWidth) ? kRoundHalfWidth[dy] : 0;
+}
+
+/* The farthest distance from the center line at which the display is at
+   least 2 * half_width wide. */
+static int16_t round_reach(int16_t half_width) {
+    int16_t dy = 0;
+    while (dy + 1 < (int16_t)ARRAY_LENGTH(kRoundHalfWidth) && kRoundHalfWidth[dy + 1] >= half_width) {
+        dy += 1;
+    }
+    return dy;
+}
+
+/* Forecast rows are as wide as the display allows at their height, between
+   the width with comfortable column spacing and the width with none. */
+static int16_t s_forecast_row_max_w;
+static int16_t s_forecast_row_min_w;
+#endif
+
 static const GCornerMask kForecastCorners = PBL_IF_RECT_ELSE(GCornersAll, GCornerNone);
 static const GTextAlignment kHeadingAlignment = PBL_IF_RECT_ELSE(GTextAlignmentLeft, GTextAlignmentCenter);
 
-static TextFitment text_fitment(const MFont* mfont, const char* text) {
+static TextFitment text_fitment(MFont* mfont, const char* text) {
     GRect box = { { 0, 0 }, { 1024, 1024 } };
     TextFitment result;
-    result.size = graphics_text_layout_get_content_size(text, mfont->gfont, box, GTextOverflowModeWordWrap, GTextAlignmentLeft);
+    result.size = graphics_text_layout_get_content_size(text, mfont_gfont(mfont), box, GTextOverflowModeWordWrap, GTextAlignmentLeft);
     int16_t margin = mfont->ascender / 2;
     result.size.w += 2 * margin;
     result.size.h = mfont->cap_height + 2 * margin;
@@ -159,12 +392,9 @@ static void layout_stuff(GRect bounds) {
 
 #if defined(PBL_ROUND)
     /* For a round layout, we want to take our minimum content width and snug
-       it up into the top of the circle as far as it will fit.  We use a radius
-       that is a little reduced from the raw display size in order to accomodate
-       the overlap of the bezel. */
-    int16_t r = 90 - 2;
+       it up into the top of the circle as far as it will fit. */
     int16_t w = kBoxSpacing / 2 + s_value_fitment.size.w;
-    int16_t pad = bounds.size.h / 2 - usqrt(r*r - w*w) / SQRT_SCALE;
+    int16_t pad = bounds.size.h / 2 - round_reach(w);
 
     /* Put the padding into the Value fitment. */
     s_value_fitment.size.h += pad;
@@ -221,19 +451,22 @@ static void layout_stuff(GRect bounds) {
 
     /* Size the forecast columns. */
     GRect bigbox = {{0,0},{100,100}};
-    GSize tsize = graphics_text_layout_get_content_size("99:99", kForecastRowFont->gfont, bigbox, GTextOverflowModeWordWrap, GTextAlignmentLeft);
+    GSize tsize = graphics_text_layout_get_content_size("99:99", mfont_gfont(kForecastRowFont), bigbox, GTextOverflowModeWordWrap, GTextAlignmentLeft);
     s_time_col_w = tsize.w;
-    tsize = graphics_text_layout_get_content_size("+99", kForecastRowFont->gfont, bigbox, GTextOverflowModeWordWrap, GTextAlignmentRight);
+    tsize = graphics_text_layout_get_content_size("+99", mfont_gfont(kForecastRowFont), bigbox, GTextOverflowModeWordWrap, GTextAlignmentRight);
     s_count_col_w = tsize.w;
-    tsize = graphics_text_layout_get_content_size("=9999", kForecastRowFont->gfont, bigbox, GTextOverflowModeWordWrap, GTextAlignmentRight);
+    tsize = graphics_text_layout_get_content_size("=9999", mfont_gfont(kForecastRowFont), bigbox, GTextOverflowModeWordWrap, GTextAlignmentRight);
     s_total_col_w = tsize.w;
 
     s_forecast_insets.top = 0;
 #if defined(PBL_ROUND)
+    /* Each row is fitted to the circle as it is drawn, so the insets only
+       apply to the headings and the empty forecast text. */
     int16_t col_spacing = kForecastRowFont->ascender;
-    w = (s_time_col_w + col_spacing + s_count_col_w + col_spacing + s_total_col_w) / 2;
-    pad = bounds.size.h / 2 - usqrt(r*r - w*w) / SQRT_SCALE;
-    s_forecast_insets.bottom = pad - bounds_inset;
+    s_forecast_row_max_w = s_time_col_w + col_spacing + s_count_col_w + col_spacing + s_total_col_w;
+    s_forecast_row_min_w = s_time_col_w + kBoxSpacing + s_count_col_w + kBoxSpacing + s_total_col_w;
+    w = s_forecast_row_max_w / 2;
+    s_forecast_insets.bottom = 0;
     s_forecast_insets.left =
     s_forecast_insets.right = s_forecast_box.size.w / 2 - w;
 #else
@@ -242,30 +475,189 @@ static void layout_stuff(GRect bounds) {
     s_forecast_insets.bottom = kForecastHeadingFont->ascender;
 #endif
 
+    /* The offline badge sits at the bottom of the forecast, centered, and on
+       a round display, as low as it fits. */
+    s_offline_fitment = text_fitment(kOfflineFont, kOfflineText);
+    s_offline_box.size = s_offline_fitment.size;
+    s_offline_box.origin.x = bounds.origin.x + (bounds.size.w - s_offline_box.size.w) / 2;
+#if defined(PBL_ROUND)
+    s_offline_box.origin.y = kRoundCenter + round_reach(s_offline_box.size.w / 2) - s_offline_box.size.h;
+#else
+    s_offline_box.origin.y = s_forecast_box.origin.y + s_forecast_box.size.h - kBoxSpacing - s_offline_box.size.h;
+#endif
+
 }
 
 // -----------------------------------------------------------------------------
 // Main Screen functions
 // -----------------------------------------------------------------------------
 
-static void update_schedule(StudySummary* q) {
-    int32_t elapsed_hours = time(NULL) / kOneHour - q->epoch_hour;
-    int32_t dest = 0;
-    for (int k = 0; k < q->forecast_length; k += 2) {
-        int hour_offset = q->forecast[k];
-        int subject_count = q->forecast[k+1];
-        if (hour_offset <= elapsed_hours) {
-            q->review_count += subject_count;
+/* Format the hour of a local time for the 12 or 24 hour clock, with the
+   minutes on the 24 hour clock if asked.
+
+   00 01 ... 11 12 13 14 ... 23
+   12  1 ... 11 12  1  2 ... 11 */
+static void format_hour(char* buffer, size_t buflen, const struct tm* local, bool clock_24h, bool minutes) {
+    if (clock_24h) {
+        if (minutes) {
+            snprintf(buffer, buflen, "%02d:%02d", local->tm_hour, local->tm_min);
         } else {
-            q->forecast[dest++] = hour_offset - elapsed_hours;
-            q->forecast[dest++] = subject_count;
+            snprintf(buffer, buflen, "%02d", local->tm_hour);
         }
+    } else {
+        int h = local->tm_hour % 12;
+        if (h == 0) h = 12;
+        char m = (local->tm_hour < 12) ? 'a' : 'p';
+        snprintf(buffer, buflen, "%u%c", h, m);
+    }
+}
+
+static void mark_layer_dirty(Layer* layer) {
+    if (layer) {
+        layer_mark_dirty(layer);
+    }
+}
+
+static void cache_value_text(AvailablesLayout* layout, uint16_t value) {
+    char text[sizeof layout->value_text];
+    snprintf(text, sizeof text, "%u", value);
+    if (strcmp(text, layout->value_text) != 0) {
+        strcpy(layout->value_text, text);
+        mark_layer_dirty(layout->layer);
+    }
+}
+
+/* Format the rows in view, starting from the scroll position.  The first row
+   in view always gets a day heading, so that the day is never off screen. */
+static void cache_forecast_rows(const StudySummary* q) {
+
+    if (s_forecast_scroll > q->forecast_length - 1) {
+        s_forecast_scroll = q->forecast_length > 0 ? q->forecast_length - 1 : 0;
     }
-    q->forecast_length = dest;
-    q->epoch_hour += elapsed_hours;
 
-    Layer* layer = window_get_root_layer(s_main_screen);
-    layer_mark_dirty(layer);
+    /* The running total counts the rows above the view too. */
+    uint16_t total_reviews = q->review_count;
+    for (int k = 0; k < s_forecast_scroll; ++k) {
+        total_reviews += forecast_entry(q, k)->count;
+    }
+
+    bool forecast_changed = false;
+    int day = -1;
+    int n = 0;
+    time_t start_of_today = time_start_of_today();
+    for (int k = s_forecast_scroll; k < q->forecast_length && n < kForecastCacheRows; ++k, ++n) {
+        ForecastRow row;
+        memset(&row, 0, sizeof row);
+        time_t row_time = forecast_hour(q, k) * kOneHour;
+        uint16_t row_reviews = forecast_entry(q, k)->count;
+        total_reviews += row_reviews;
+
+        int row_day = row_time < start_of_today ? 0 : (row_time - start_of_today) / kOneDay;
+        if (row_day != day) {
+            day = row_day;
+            if (day < (int)ARRAY_LENGTH(kDayLabel)) {
+                strncpy(row.heading, kDayLabel[day], sizeof row.heading - 1);
+            } else {
+                strftime(row.heading, sizeof row.heading, "%A", localtime(&row_time));
+            }
+        }
+
+        format_hour(row.label_text, sizeof row.label_text, localtime(&row_time), s_forecast_clock_24h, true);
+        snprintf(row.count_text, sizeof row.count_text, "+%u", row_reviews);
+        snprintf(row.total_text, sizeof row.total_text, "%u", total_reviews);
+
+        if (memcmp(&row, &s_forecast_rows[n], sizeof row) != 0) {
+            s_forecast_rows[n] = row;
+            forecast_changed = true;
+        }
+    }
+    if (n != s_forecast_row_count) {
+        s_forecast_row_count = n;
+        forecast_changed = true;
+    }
+    if (forecast_changed) {
+        mark_layer_dirty(s_forecast_layer);
+    }
+}
+
+/* Gather the histogram bars, and have the histogram drawn again only if they
+   have changed. */
+static void cache_histogram(const StudySummary* q) {
+    Histogram histogram;
+    memset(&histogram, 0, sizeof histogram);
+    histogram.base_hour = q->epoch_hour;
+    histogram.clock_24h = s_forecast_clock_24h;
+    for (int k = 0; k < q->forecast_length; ++k) {
+        int32_t bar = forecast_hour(q, k) - q->epoch_hour - 1;
+        if (bar >= kHistogramHours) {
+            break;
+        }
+        if (bar >= 0) {
+            histogram.bars[bar] = forecast_entry(q, k)->count;
+        }
+    }
+    if (memcmp(&histogram, &s_histogram, sizeof histogram) != 0) {
+        s_histogram = histogram;
+        s_histogram_captured = false;
+        if (s_forecast_view == kForecastViewHistogram) {
+            mark_layer_dirty(s_forecast_layer);
+        }
+    }
+}
+
+/* Format the SRS stage rows, under a heading with the level progress. */
+static void cache_stage_rows(const StudyProgress* progress) {
+    bool stages_changed = false;
+    for (int k = 0; k < kSrsStageGroups; ++k) {
+        ForecastRow row;
+        memset(&row, 0, sizeof row);
+        if (k == 0) {
+            snprintf(row.heading, sizeof row.heading, kStagesHeadingFormat,
+                progress->level, progress->level_passed, progress->level_total);
+        }
+        strncpy(row.label_text, kSrsStageLabel[k], sizeof row.label_text - 1);
+        snprintf(row.total_text, sizeof row.total_text, "%u", progress->stage_counts[k]);
+        if (memcmp(&row, &s_stage_rows[k], sizeof row) != 0) {
+            s_stage_rows[k] = row;
+            stages_changed = true;
+        }
+    }
+    if (stages_changed && s_forecast_view == kForecastViewStages) {
+        mark_layer_dirty(s_forecast_layer);
+    }
+}
+
+/* Refresh the cached text, and mark dirty only the layers whose text has
+   actually changed. */
+static void cache_study_summary(const StudySummary* q) {
+    cache_value_text(&s_lessons_layout, q->lesson_count);
+    cache_value_text(&s_reviews_layout, q->review_count);
+    s_forecast_clock_24h = clock_is_24h_style();
+    cache_forecast_rows(q);
+    cache_histogram(q);
+}
+
+static void schedule_refresh(const StudySummary* q);
+
+/* Move the summary forward to the current hour, adding the reviews that have
+   become available since to the review count. */
+static void age_summary(StudySummary* q) {
+    int32_t now_hour = time(NULL) / kOneHour;
+    while (q->forecast_length > 0 && forecast_hour(q, 0) <= now_hour) {
+        q->review_count += forecast_entry(q, 0)->count;
+        q->forecast_head = (q->forecast_head + 1) % kForecastCapacity;
+        q->forecast_length -= 1;
+        if (s_forecast_scroll > 0) {
+            s_forecast_scroll -= 1;
+        }
+    }
+    q->epoch_hour = now_hour;
+}
+
+static void update_schedule(StudySummary* q) {
+    age_summary(q);
+    cache_study_summary(q);
+    schedule_refresh(q);
 }
 
 static void refresh_timer_callback(void* data) {
@@ -277,147 +669,433 @@ static inline time_t first_of(time_t a, time_t b) {
     return a < b ? a : b;
 }
 
-static void draw_available(GContext* ctx, AvailablesLayout* layout, int value) {
+/* Arrange for update_schedule() to run when the next review in the forecast
+   becomes available, or at midnight when the day headings change, whichever
+   comes first.  This is called only when the summary changes. */
+static void schedule_refresh(const StudySummary* q) {
+    if (q->forecast_length == 0) {
+        if (s_refresh_timer) {
+            app_timer_cancel(s_refresh_timer);
+            s_refresh_timer = NULL;
+        }
+        return;
+    }
+
+    time_t now = time(NULL); // {epoch seconds}
+    time_t tomorrow = time_start_of_today() + kOneDay;
+    time_t nextForecast = forecast_hour(q, 0) * kOneHour;
+    time_t refreshAt = first_of(tomorrow, nextForecast);
+    time_t refreshIn = refreshAt - now;
+    if (refreshIn < 0) {
+        refreshIn = 0;
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "refresh in %02lu:%02lu:%02lu, at %02lu:%02lu:%02luZ\n",
+         refreshIn / 3600,       (refreshIn / 60) % 60, refreshIn % 60,
+        (refreshAt / 3600) % 24, (refreshAt / 60) % 60, refreshAt % 60);
+
+    uint32_t timeout_ms = refreshIn * 1000;
+    if (!s_refresh_timer || !app_timer_reschedule(s_refresh_timer, timeout_ms)) {
+        s_refresh_timer = app_timer_register(timeout_ms, &refresh_timer_callback, NULL);
+    }
+}
+
+static void draw_available(Layer* layer, GContext* ctx) {
+
+    AvailablesLayout* layout = *(AvailablesLayout**)layer_get_data(layer);
+    GRect box = layer_get_bounds(layer);
 
     /* Fill the whole box. */
     graphics_context_set_fill_color(ctx, layout->color);
-    graphics_fill_rect(ctx, layout->box, kBoxCornerRadius, GCornersAll & layout->corner_mask);
+    graphics_fill_rect(ctx, box, kBoxCornerRadius, GCornersAll & layout->corner_mask);
 
     /* Fill the label inset box. */
-    GRect ibox = grect_inset(layout->box, layout->insets);
+    GRect ibox = grect_inset(box, layout->insets);
     graphics_context_set_fill_color(ctx, kLabelInsetColor);
     graphics_fill_rect(ctx, ibox, kBoxCornerRadius - kBoxStrokeWidth, GCornersBottom & layout->corner_mask);
 
     /* Draw the label text. */
     GRect tbox = grect_inset(ibox, s_label_fitment.insets);
     graphics_context_set_text_color(ctx, kLabelTextColor);
-    graphics_draw_text(ctx, layout->label, kLabelFont->gfont, tbox, GTextOverflowModeWordWrap, layout->alignment, NULL);
+    graphics_draw_text(ctx, layout->label, mfont_gfont(kLabelFont), tbox, GTextOverflowModeWordWrap, layout->alignment, NULL);
 
     /* Draw the value text. */
-    ibox = layout->box;
+    ibox = box;
     ibox.size.h = s_value_fitment.size.h;
     tbox = grect_inset(ibox, s_value_fitment.insets);
-    char* buffer = s_scratch_text_buffer;
-    size_t buflen = sizeof s_scratch_text_buffer;
-    snprintf(buffer, buflen, "%u", value);
     graphics_context_set_text_color(ctx, kValueTextColor);
-    graphics_draw_text(ctx, buffer, kValueFont->gfont, tbox, GTextOverflowModeWordWrap, layout->alignment, NULL);
+    graphics_draw_text(ctx, layout->value_text, mfont_gfont(kValueFont), tbox, GTextOverflowModeWordWrap, layout->alignment, NULL);
 }
 
-static GRect draw_forecast_row(GContext* ctx, GRect box, time_t time, uint16_t count, uint16_t total) {
+static GRect draw_forecast_row(GContext* ctx, GRect box, const ForecastRow* row) {
 
-    const MFont* font = kForecastRowFont;
-    struct tm* local = localtime(&time);
-    char* buffer = s_scratch_text_buffer;
-    size_t buflen = sizeof s_scratch_text_buffer;
+    MFont* font = kForecastRowFont;
     GRect tbox = box;
     tbox.size.h = font->ascender + font->cap_height;
-    
-    /* 00 01 ... 11 12 13 14 ... 23
-       12  1 ... 11 12  1  2 ... 11 */
-    if (clock_is_24h_style()) {
-        snprintf(buffer, buflen, "%02d:%02d", local->tm_hour, local->tm_min);
-    } else {
-        int h = local->tm_hour % 12;
-        if (h == 0) h = 12;
-        char m = (local->tm_hour < 12) ? 'a' : 'p';
-        snprintf(buffer, buflen, "%u%c", h, m);
-    }
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "%s +%u =%u", buffer, count, total);
-    graphics_draw_text(ctx, buffer, font->gfont, tbox, GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
 
-    snprintf(buffer, buflen, "%u", total);
-    graphics_draw_text(ctx, buffer, font->gfont, tbox, GTextOverflowModeWordWrap, GTextAlignmentRight, NULL);
+    graphics_draw_text(ctx, row->label_text, mfont_gfont(font), tbox, GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+    graphics_draw_text(ctx, row->total_text, mfont_gfont(font), tbox, GTextOverflowModeWordWrap, GTextAlignmentRight, NULL);
 
     tbox.size.w -= s_total_col_w;
-    snprintf(buffer, buflen, "+%u", count);
-    graphics_draw_text(ctx, buffer, font->gfont, tbox, GTextOverflowModeWordWrap, GTextAlignmentRight, NULL);
-    
+    graphics_draw_text(ctx, row->count_text, mfont_gfont(font), tbox, GTextOverflowModeWordWrap, GTextAlignmentRight, NULL);
+
     box.origin.y += tbox.size.h;
     box.size.h -= tbox.size.h;
     return box;
 }
 
-static void draw_main_screen(Layer* layer, GContext* ctx) {
+#if defined(PBL_ROUND)
+/* Center the row box horizontally in the widest span of the display that
+   it fits over its whole height.  Return false if it does not fit. */
+static bool fit_round_row(GRect frame, GRect* box, int16_t height) {
+    int16_t top = frame.origin.y + box->origin.y;
+    int16_t bottom = top + height - 1;
+    int16_t top_w = round_half_width(top);
+    int16_t bottom_w = round_half_width(bottom);
+    int16_t width = 2 * (top_w < bottom_w ? top_w : bottom_w);
+    if (width < s_forecast_row_min_w) {
+        return false;
+    }
+    if (width > s_forecast_row_max_w) {
+        width = s_forecast_row_max_w;
+    }
+    box->origin.x = kRoundCenter - frame.origin.x - width / 2;
+    box->size.w = width;
+    return true;
+}
+#endif
 
-    StudySummary* q = &s_summary;
+/* The part of the forecast box that its content is drawn in, which stops
+   short of the offline badge while it is shown. */
+static GRect forecast_content_box(Layer* layer) {
+    GRect box = grect_inset(layer_get_bounds(layer), s_forecast_insets);
+    if (s_offline) {
+        int16_t badge_top = s_offline_box.origin.y - layer_get_frame(layer).origin.y;
+        if (box.origin.y + box.size.h > badge_top) {
+            box.size.h = badge_top - box.origin.y;
+        }
+    }
+    return box;
+}
+
+static void render_histogram(Layer* layer, GContext* ctx) {
+
+    const Histogram* histogram = &s_histogram;
     GRect bounds = layer_get_bounds(layer);
-    GRect box;
 
-    /* Schedule a refresh for the first review in the forecast. */
-    if (s_refresh_timer) {
-        app_timer_cancel(s_refresh_timer);
-        s_refresh_timer = NULL;
+    graphics_context_set_fill_color(ctx, kForecastBoxColor);
+    graphics_fill_rect(ctx, bounds, kBoxCornerRadius, kForecastCorners);
+
+    GRect box = forecast_content_box(layer);
+    graphics_context_set_text_color(ctx, kForecastTextColor);
+
+    uint16_t peak = 0;
+    for (int k = 0; k < kHistogramHours; ++k) {
+        if (histogram->bars[k] > peak) {
+            peak = histogram->bars[k];
+        }
     }
-    if (q->forecast_length > 0) {
-        time_t now = time(NULL); // {epoch seconds}
-        time_t tomorrow = time_start_of_today() + kOneDay;
-        time_t nextForecast = (q->epoch_hour + q->forecast[0]) * kOneHour;
-        time_t refreshAt = first_of(tomorrow, nextForecast);
-        time_t refreshIn = refreshAt - now;
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "refresh in %02lu:%02lu:%02lu, at %02lu:%02lu:%02luZ\n",
-             refreshIn / 3600,       (refreshIn / 60) % 60, refreshIn % 60,
-            (refreshAt / 3600) % 24, (refreshAt / 60) % 60, refreshAt % 60);
-        s_refresh_timer = app_timer_register(refreshIn * 1000, &refresh_timer_callback, NULL);
+    if (peak == 0) {
+        graphics_draw_text(ctx, kEmptyForecastText, mfont_gfont(kEmptyForecastFont), box, GTextOverflowModeFill, GTextAlignmentCenter, s_layout_attributes);
+        return;
     }
 
-    /* Clear the layer. */
-    graphics_context_set_fill_color(ctx, kMainWindowColor);
-    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+    MFont* font = kHistogramLabelFont;
+    int16_t label_height = font->ascender + font->cap_height;
+    char text[32];
+    snprintf(text, sizeof text, kHistogramHeadingFormat, peak);
+    graphics_draw_text(ctx, text, mfont_gfont(font), box, GTextOverflowModeWordWrap, kHeadingAlignment, NULL);
 
-    draw_available(ctx, &s_lessons_layout, q->lesson_count);
-    draw_available(ctx, &s_reviews_layout, q->review_count);
+    /* The bars sit between the heading and a line of hour labels. */
+    GRect chart = box;
+    chart.origin.y += label_height;
+    chart.size.h -= 2 * label_height;
+#if defined(PBL_ROUND)
+    /* Keep the hour labels above the part of the circle that is too narrow
+       for bars of the minimum width, and fit the chart to the display at
+       the bottom of the labels. */
+    GRect frame = layer_get_frame(layer);
+    int16_t bottom = kRoundCenter + round_reach(kHistogramHours * kRoundMinBarWidth / 2 + kBoxSpacing) - frame.origin.y;
+    if (chart.origin.y + chart.size.h + label_height > bottom) {
+        chart.size.h = bottom - label_height - chart.origin.y;
+    }
+    int16_t half_width = round_half_width(frame.origin.y + chart.origin.y + chart.size.h + label_height) - kBoxSpacing;
+    if (chart.size.w > 2 * half_width) {
+        chart.origin.x = kRoundCenter - frame.origin.x - half_width;
+        chart.size.w = 2 * half_width;
+    }
+#endif
+    int16_t bar_w = chart.size.w / kHistogramHours;
+    chart.origin.x += (chart.size.w - bar_w * kHistogramHours) / 2;
+    chart.size.w = bar_w * kHistogramHours;
+    int16_t baseline = chart.origin.y + chart.size.h;
+
+    graphics_context_set_fill_color(ctx, kHistogramBarColor);
+    for (int k = 0; k < kHistogramHours; ++k) {
+        int16_t h = histogram->bars[k] * chart.size.h / peak;
+        if (h == 0 && histogram->bars[k] > 0) {
+            h = 1;
+        }
+        GRect bar = GRect(chart.origin.x + k * bar_w, baseline - h, bar_w > 2 ? bar_w - 1 : bar_w, h);
+        graphics_fill_rect(ctx, bar, 0, GCornerNone);
+    }
 
-    /* Draw the box for the review forecast. */
-    graphics_context_set_fill_color(ctx, kForecastBoxColor);
-    graphics_fill_rect(ctx, s_forecast_box, kBoxCornerRadius, kForecastCorners);
+    /* Label every sixth hour of the local day. */
+    graphics_context_set_stroke_color(ctx, kForecastTextColor);
+    graphics_draw_line(ctx, GPoint(chart.origin.x, baseline), GPoint(chart.origin.x + chart.size.w - 1, baseline));
+    for (int k = 0; k < kHistogramHours; ++k) {
+        time_t bar_time = (histogram->base_hour + 1 + k) * kOneHour;
+        struct tm* local = localtime(&bar_time);
+        if (local->tm_hour % 6 != 0) {
+            continue;
+        }
+        int16_t x = chart.origin.x + k * bar_w;
+        graphics_draw_line(ctx, GPoint(x, baseline), GPoint(x, baseline + 2));
+        format_hour(text, sizeof text, local, histogram->clock_24h, false);
+        GRect tbox = GRect(x - 3 * bar_w, baseline, 6 * bar_w, label_height);
+        graphics_draw_text(ctx, text, mfont_gfont(font), tbox, GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    }
+}
 
-    box = grect_inset(s_forecast_box, s_forecast_insets);
-    const MFont* heading_font = kForecastHeadingFont;
-    graphics_context_set_text_color(ctx, kForecastTextColor);
+/* Copy the histogram from the frame buffer into the cached bitmap.  The
+   bitmap is as wide as the display, so that rows can be copied whole, and its
+   bounds select the layer.  Color displays are 8 bits per pixel, but the round
+   display only stores the visible span of each row. */
+static bool capture_histogram(Layer* layer, GContext* ctx) {
+    GRect bounds = layer_get_bounds(layer);
+    GRect frame = layer_convert_rect_to_screen(layer, GRect(0, 0, bounds.size.w, bounds.size.h));
+    GBitmap* frame_buffer = graphics_capture_frame_buffer(ctx);
+    if (!frame_buffer) {
+        return false;
+    }
 
-    if (q->forecast_length == 0) {
-        graphics_draw_text(ctx, kEmptyForecastText, kEmptyForecastFont->gfont, box, GTextOverflowModeFill, GTextAlignmentCenter, s_layout_attributes);
+    /* The layer should be on the display, but never copy from outside it. */
+    GRect display = gbitmap_get_bounds(frame_buffer);
+    if (frame.origin.x < 0 || frame.origin.y < 0
+     || frame.origin.x + frame.size.w > display.size.w
+     || frame.origin.y + frame.size.h > display.size.h) {
+        graphics_release_frame_buffer(ctx, frame_buffer);
+        return false;
+    }
+
+    if (!s_histogram_bitmap) {
+        GSize size = { gbitmap_get_bounds(frame_buffer).size.w, frame.size.h };
+        s_histogram_bitmap = gbitmap_create_blank(size, PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+        if (s_histogram_bitmap) {
+            gbitmap_set_bounds(s_histogram_bitmap, GRect(frame.origin.x, 0, frame.size.w, frame.size.h));
+        }
+    }
+
+    if (s_histogram_bitmap) {
+        for (int16_t y = 0; y < frame.size.h; ++y) {
+#if defined(PBL_COLOR)
+            GBitmapDataRowInfo src = gbitmap_get_data_row_info(frame_buffer, frame.origin.y + y);
+            GBitmapDataRowInfo dst = gbitmap_get_data_row_info(s_histogram_bitmap, y);
+            int16_t x0 = src.min_x > frame.origin.x ? src.min_x : frame.origin.x;
+            int16_t x1 = src.max_x < frame.origin.x + frame.size.w - 1 ? src.max_x : frame.origin.x + frame.size.w - 1;
+            if (x0 <= x1) {
+                memcpy(dst.data + x0, src.data + x0, x1 - x0 + 1);
+            }
+#else
+            uint16_t src_stride = gbitmap_get_bytes_per_row(frame_buffer);
+            uint16_t dst_stride = gbitmap_get_bytes_per_row(s_histogram_bitmap);
+            memcpy(gbitmap_get_data(s_histogram_bitmap) + y * dst_stride,
+                   gbitmap_get_data(frame_buffer) + (frame.origin.y + y) * src_stride,
+                   src_stride < dst_stride ? src_stride : dst_stride);
+#endif
+        }
+    }
+
+    graphics_release_frame_buffer(ctx, frame_buffer);
+    return s_histogram_bitmap != NULL;
+}
+
+/* Draw the histogram from the captured bitmap if there is one.  Otherwise
+   render it, and capture it if the main screen is settled on top; while it is
+   sliding in or out, or covered, the frame buffer is not to be trusted. */
+static void draw_histogram(Layer* layer, GContext* ctx) {
+    if (s_histogram_captured) {
+        graphics_draw_bitmap_in_rect(ctx, s_histogram_bitmap, layer_get_bounds(layer));
         return;
     }
+    render_histogram(layer, ctx);
+    if (s_main_screen_settled && window_stack_get_top_window() == s_main_screen) {
+        s_histogram_captured = capture_histogram(layer, ctx);
+    }
+}
 
-    const MFont* row_font = kForecastRowFont;
+/* Draw as many of the rows, with their headings, as fit in the box, and
+   return how many that was.  The frame is that of the layer, for fitting the
+   rows to a round display. */
+static int draw_row_list(GContext* ctx, GRect box, GRect frame, const ForecastRow* rows, int count) {
+
+    MFont* heading_font = kForecastHeadingFont;
+    MFont* row_font = kForecastRowFont;
     uint16_t heading_height = heading_font->ascender + heading_font->cap_height;
     uint16_t row_height = row_font->ascender + row_font->cap_height;
 
-    int day = -1;
-    uint16_t total_reviews = q->review_count;
-    time_t end_of_day = time_start_of_today();
-    for (int k = 0; k < q->forecast_length; k += 2) {
-        time_t row_time = (q->epoch_hour + q->forecast[k]) * kOneHour;
-        uint16_t row_reviews = q->forecast[k+1];
-        total_reviews += row_reviews;
-        if (row_time >= end_of_day) {
+    int n = 0;
+    for (; n < count; ++n) {
+        const ForecastRow* row = &rows[n];
+        if (row->heading[0]) {
             if (box.size.h < (heading_height + row_height)) {
                 break;
             }
-            while (row_time >= end_of_day) {
-                day += 1;
-                end_of_day += kOneDay;
-            }
-            const char* day_label;
-            if (day < (int)ARRAY_LENGTH(kDayLabel)) {
-                day_label = kDayLabel[day];
-            } else {
-                struct tm* local = localtime(&row_time);
-                strftime(s_scratch_text_buffer, sizeof s_scratch_text_buffer, "%A", local);
-                day_label = s_scratch_text_buffer;
+#if defined(PBL_ROUND)
+            GRect next_box = box;
+            next_box.origin.y += heading_height;
+            if (!fit_round_row(frame, &next_box, row_height)) {
+                break;
             }
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "%s", kDayLabel[day]);
-            graphics_draw_text(ctx, day_label, heading_font->gfont, box, GTextOverflowModeWordWrap, kHeadingAlignment, NULL);
+#endif
+            graphics_draw_text(ctx, row->heading, mfont_gfont(heading_font), box, GTextOverflowModeWordWrap, kHeadingAlignment, NULL);
             box.origin.y += heading_height;
             box.size.h -= heading_height;
         }
         if (box.size.h < row_height) {
             break;
         }
-        box = draw_forecast_row(ctx, box, row_time, row_reviews, total_reviews);
+#if defined(PBL_ROUND)
+        if (!fit_round_row(frame, &box, row_height)) {
+            break;
+        }
+#endif
+        box = draw_forecast_row(ctx, box, row);
+    }
+    return n;
+}
+
+static void draw_forecast_content(Layer* layer, GContext* ctx) {
+
+    if (s_forecast_view == kForecastViewHistogram) {
+        draw_histogram(layer, ctx);
+        return;
+    }
+
+    StudySummary* q = &s_summary;
+    GRect bounds = layer_get_bounds(layer);
+    GRect frame = layer_get_frame(layer);
+
+    /* Draw the box for the review forecast. */
+    graphics_context_set_fill_color(ctx, kForecastBoxColor);
+    graphics_fill_rect(ctx, bounds, kBoxCornerRadius, kForecastCorners);
+
+    GRect box = forecast_content_box(layer);
+    graphics_context_set_text_color(ctx, kForecastTextColor);
+
+    if (s_forecast_view == kForecastViewStages) {
+        draw_row_list(ctx, box, frame, s_stage_rows, kSrsStageGroups);
+        return;
+    }
+
+    if (q->forecast_length == 0) {
+        graphics_draw_text(ctx, kEmptyForecastText, mfont_gfont(kEmptyForecastFont), box, GTextOverflowModeFill, GTextAlignmentCenter, s_layout_attributes);
+        return;
+    }
+
+    s_forecast_rows_drawn = draw_row_list(ctx, box, frame, s_forecast_rows, s_forecast_row_count);
+}
+
+/* The forecast is the last of the main screen layers to be drawn. */
+static void draw_forecast(Layer* layer, GContext* ctx) {
+    draw_forecast_content(layer, ctx);
+    perf_redraw_end();
+}
+
+static void draw_perf_overlay(Layer* layer, GContext* ctx) {
+    GRect box = layer_get_bounds(layer);
+    char text[96];
+    snprintf(text, sizeof text,
+        "draw %lu avg %lu max %lu\nready %lu sync %lu\nin %lu heap %lu",
+        (unsigned long)s_perf.redraw_count,
+        (unsigned long)(s_perf.redraw_count ? s_perf.redraw_ms_total / s_perf.redraw_count : 0),
+        (unsigned long)s_perf.redraw_ms_max,
+        (unsigned long)s_perf.launch_to_refresh_ms,
+        (unsigned long)s_perf.refresh_to_success_ms,
+        (unsigned long)s_perf.inbox_bytes,
+        (unsigned long)s_perf.heap_free_min);
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, box, 0, GCornerNone);
+    graphics_context_set_text_color(ctx, GColorWhite);
+    graphics_draw_text(ctx, text, mfont_gfont(kPerfOverlayFont), box,
+        GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+}
+
+static void draw_offline_badge(Layer* layer, GContext* ctx) {
+    GRect box = layer_get_bounds(layer);
+    graphics_context_set_fill_color(ctx, kOfflineColor);
+    graphics_fill_rect(ctx, box, kBoxCornerRadius, GCornersAll);
+    graphics_context_set_text_color(ctx, kOfflineTextColor);
+    graphics_draw_text(ctx, kOfflineText, mfont_gfont(kOfflineFont), grect_inset(box, s_offline_fitment.insets),
+        GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+}
+
+/* Show or hide the badge that says the summary on display could not be
+   refreshed. */
+static void set_offline(bool offline) {
+    if (offline == s_offline) {
+        return;
     }
+    s_offline = offline;
+    if (s_offline_layer) {
+        layer_set_hidden(s_offline_layer, !offline);
+    }
+    s_histogram_captured = false;
+    mark_layer_dirty(s_forecast_layer);
+}
+
+static void toggle_perf_overlay(ClickRecognizerRef recognizer, void* context) {
+    layer_set_hidden(s_perf_layer, !layer_get_hidden(s_perf_layer));
+}
+
+/* Scroll the forecast by one row.  Scrolling down stops once the last row
+   is in view. */
+static void scroll_forecast_up(ClickRecognizerRef recognizer, void* context) {
+    if (s_forecast_view == kForecastViewRows && s_forecast_scroll > 0) {
+        s_forecast_scroll -= 1;
+        cache_forecast_rows(&s_summary);
+    }
+}
+
+static void scroll_forecast_down(ClickRecognizerRef recognizer, void* context) {
+    if (s_forecast_view == kForecastViewRows && s_forecast_scroll + s_forecast_rows_drawn < s_summary.forecast_length) {
+        s_forecast_scroll += 1;
+        cache_forecast_rows(&s_summary);
+    }
+}
+
+static void toggle_forecast_view(ClickRecognizerRef recognizer, void* context) {
+    s_forecast_view = (s_forecast_view + 1) % kForecastViewCount;
+    if (s_forecast_view == kForecastViewStages && s_progress.level == 0) {
+        s_forecast_view = kForecastViewRows;
+    }
+    mark_layer_dirty(s_forecast_layer);
+}
+
+static void main_screen_click_config(void* context) {
+    window_single_click_subscribe(BUTTON_ID_SELECT, &toggle_forecast_view);
+    window_single_repeating_click_subscribe(BUTTON_ID_UP, 100, &scroll_forecast_up);
+    window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, &scroll_forecast_down);
+    window_long_click_subscribe(BUTTON_ID_SELECT, 0, &toggle_perf_overlay, NULL);
+}
+
+static void draw_main_screen(Layer* layer, GContext* ctx) {
+    perf_redraw_begin();
+
+    /* Clear the layer. */
+    graphics_context_set_fill_color(ctx, kMainWindowColor);
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+}
+
+static Layer* create_available_layer(AvailablesLayout* layout) {
+    Layer* layer = layer_create_with_data(layout->box, sizeof layout);
+    *(AvailablesLayout**)layer_get_data(layer) = layout;
+    layer_set_update_proc(layer, &draw_available);
+    return layer;
+}
+
+static void log_heap_usage(const char* when) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "heap %s: %u used, %u free", when,
+        (unsigned)heap_bytes_used(), (unsigned)heap_bytes_free());
 }
 
 static void load_main_screen(Window* window) {
@@ -425,17 +1103,91 @@ static void load_main_screen(Window* window) {
     GRect bounds = layer_get_bounds(layer);
     layout_stuff(bounds);
     layer_set_update_proc(layer, &draw_main_screen);
+
+    /* Each part of the screen is its own layer, so that a change to one of
+       the values does not need to invalidate the others. */
+    s_lessons_layout.layer = create_available_layer(&s_lessons_layout);
+    s_reviews_layout.layer = create_available_layer(&s_reviews_layout);
+    s_forecast_layer = layer_create(s_forecast_box);
+    layer_set_update_proc(s_forecast_layer, &draw_forecast);
+    layer_add_child(layer, s_lessons_layout.layer);
+    layer_add_child(layer, s_reviews_layout.layer);
+    layer_add_child(layer, s_forecast_layer);
+
+    s_offline_layer = layer_create(s_offline_box);
+    layer_set_update_proc(s_offline_layer, &draw_offline_badge);
+    layer_set_hidden(s_offline_layer, !s_offline);
+    layer_add_child(layer, s_offline_layer);
+
+    /* The counters overlay is hidden until asked for. */
+    GRect perf_box = bounds;
+    perf_box.size.h = 3 * (kPerfOverlayFont->ascender + kPerfOverlayFont->cap_height);
+    perf_box.origin.y = bounds.origin.y + (bounds.size.h - perf_box.size.h) / 2;
+    s_perf_layer = layer_create(perf_box);
+    layer_set_update_proc(s_perf_layer, &draw_perf_overlay);
+    layer_set_hidden(s_perf_layer, true);
+    layer_add_child(layer, s_perf_layer);
+
+    log_heap_usage("after layout");
+}
+
+static void main_screen_settled(void* data) {
+    s_main_screen_settle_timer = NULL;
+    s_main_screen_settled = true;
+    if (s_forecast_view == kForecastViewHistogram && !s_histogram_captured) {
+        mark_layer_dirty(s_forecast_layer);
+    }
+}
+
+static void cancel_main_screen_settle(void) {
+    s_main_screen_settled = false;
+    if (s_main_screen_settle_timer) {
+        app_timer_cancel(s_main_screen_settle_timer);
+        s_main_screen_settle_timer = NULL;
+    }
+}
+
+static void appear_main_screen(Window* window) {
+    /* The clock style may have been changed in the system settings while the
+       app was in the background. */
+    if (clock_is_24h_style() != s_forecast_clock_24h) {
+        cache_study_summary(&s_summary);
+    }
+    cancel_main_screen_settle();
+    s_main_screen_settle_timer = app_timer_register(kMainScreenSettleMs, &main_screen_settled, NULL);
+}
+
+static void disappear_main_screen(Window* window) {
+    cancel_main_screen_settle();
 }
 
 static void unload_main_screen(Window* window) {
+    if (s_histogram_bitmap) {
+        gbitmap_destroy(s_histogram_bitmap);
+        s_histogram_bitmap = NULL;
+        s_histogram_captured = false;
+    }
+    layer_destroy(s_perf_layer);
+    layer_destroy(s_offline_layer);
+    layer_destroy(s_forecast_layer);
+    layer_destroy(s_reviews_layout.layer);
+    layer_destroy(s_lessons_layout.layer);
+    s_perf_layer = NULL;
+    s_offline_layer = NULL;
+    s_forecast_layer = NULL;
+    s_reviews_layout.layer = NULL;
+    s_lessons_layout.layer = NULL;
 }
 
 Window* create_main_screen() {
     Window* window = window_create();
     window_set_window_handlers(window, (WindowHandlers) {
         .load = load_main_screen,
+        .appear = appear_main_screen,
+        .disappear = disappear_main_screen,
         .unload = unload_main_screen,
     });
+    window_set_click_config_provider(window, &main_screen_click_config);
     return window;
 }
 
@@ -465,7 +1217,7 @@ static void draw_text_screen(Layer* layer, GContext* ctx, const char* text, GFon
 static void draw_loading_screen(Layer* layer, GContext* ctx) {
     graphics_context_set_text_color(ctx, GColorBlack);
     graphics_context_set_fill_color(ctx, GColorWhite);
-    draw_text_screen(layer, ctx, s_loading_text_buffer, kLoadScreenFont->gfont);
+    draw_text_screen(layer, ctx, s_loading_text_buffer, mfont_gfont(kLoadScreenFont));
 }
 
 static void load_loading_screen(Window* window) {
@@ -492,7 +1244,7 @@ Window* create_loading_screen() {
 static void draw_message_screen(Layer* layer, GContext* ctx) {
     graphics_context_set_fill_color(ctx, s_message_fill_color);
     graphics_context_set_text_color(ctx, s_message_text_color);
-    draw_text_screen(layer, ctx, s_message_text_buffer, kMessageScreenFont->gfont);
+    draw_text_screen(layer, ctx, s_message_text_buffer, mfont_gfont(kMessageScreenFont));
 }
 
 static void load_message_screen(Window* window) {
@@ -522,6 +1274,125 @@ static void show_error_screen(const char* message) {
     window_stack_remove(s_load_screen, false);
 }
 
+// -----------------------------------------------------------------------------
+// Persistent Storage
+// -----------------------------------------------------------------------------
+
+/* The last successfully received summary is kept in persistent storage so
+   that it can be shown immediately at the next launch.  Persistent values are
+   limited to PERSIST_DATA_MAX_LENGTH bytes each, so the forecast is split
+   over a run of consecutive keys following the header. */
+
+enum {
+    kPersistSummaryHeader   = 1,
+    kPersistSummaryForecast = 2,
+    kPersistStudyProgress   = 32, // well past the run of forecast keys.
+};
+
+static const uint8_t kPersistSummaryVersion = 4;
+
+/* The forecast entries are stored in order, starting from the head. */
+enum { kPersistForecastEntries = PERSIST_DATA_MAX_LENGTH / sizeof(ForecastEntry) };
+
+typedef struct PersistedSummaryHeader {
+    uint8_t version;
+    uint16_t lesson_count;
+    uint16_t review_count;
+    int32_t epoch_hour;
+    int32_t fetched_at;
+    int32_t base_hour;
+    int32_t forecast_length;
+    uint16_t freshness_ttl;
+} PersistedSummaryHeader;
+
+static void save_summary(const StudySummary* q) {
+    PersistedSummaryHeader header = {
+        .version = kPersistSummaryVersion,
+        .lesson_count = q->lesson_count,
+        .review_count = q->review_count,
+        .epoch_hour = q->epoch_hour,
+        .fetched_at = q->fetched_at,
+        .base_hour = q->base_hour,
+        .forecast_length = q->forecast_length,
+        .freshness_ttl = s_freshness_ttl,
+    };
+    ForecastEntry chunk[kPersistForecastEntries];
+    uint32_t key = kPersistSummaryForecast;
+    for (int k = 0; k < q->forecast_length; k += kPersistForecastEntries) {
+        int n = 0;
+        while (n < kPersistForecastEntries && k + n < q->forecast_length) {
+            chunk[n] = *forecast_entry(q, k + n);
+            n += 1;
+        }
+        persist_write_data(key++, chunk, n * sizeof(ForecastEntry));
+    }
+    persist_write_data(kPersistSummaryHeader, &header, sizeof header);
+}
+
+static bool load_summary(StudySummary* q) {
+    PersistedSummaryHeader header;
+    if (persist_read_data(kPersistSummaryHeader, &header, sizeof header) != sizeof header
+     || header.version != kPersistSummaryVersion
+     || header.forecast_length < 0
+     || header.forecast_length > kForecastCapacity) {
+        return false;
+    }
+
+    /* Read the entries aside, and only replace the summary once all of them
+       have been read, so that a short read leaves it as it was.  This runs
+       once, at launch, so the stack can spare the buffer. */
+    ForecastEntry forecast[kForecastCapacity];
+    uint8_t* data = (uint8_t*)forecast;
+    int32_t size = header.forecast_length * sizeof(ForecastEntry);
+    uint32_t key = kPersistSummaryForecast;
+    for (int32_t k = 0; k < size; k += kPersistForecastEntries * sizeof(ForecastEntry)) {
+        int32_t chunk = size - k;
+        if (chunk > (int32_t)(kPersistForecastEntries * sizeof(ForecastEntry))) {
+            chunk = kPersistForecastEntries * sizeof(ForecastEntry);
+        }
+        if (persist_read_data(key++, data + k, chunk) != chunk) {
+            return false;
+        }
+    }
+
+    /* The entries go into the ring buffer from a head of zero. */
+    memcpy(q->forecast, forecast, size);
+    q->lesson_count = header.lesson_count;
+    q->review_count = header.review_count;
+    q->epoch_hour = header.epoch_hour;
+    q->fetched_at = header.fetched_at;
+    q->base_hour = header.base_hour;
+    q->forecast_head = 0;
+    q->forecast_length = header.forecast_length;
+    s_freshness_ttl = header.freshness_ttl;
+    return true;
+}
+
+/* The study progress is small enough to be stored as is. */
+static void save_progress(const StudyProgress* progress) {
+    persist_write_data(kPersistStudyProgress, progress, sizeof *progress);
+}
+
+static bool load_progress(StudyProgress* progress) {
+    if (persist_read_data(kPersistStudyProgress, progress, sizeof *progress) != sizeof *progress) {
+        memset(progress, 0, sizeof *progress);
+        return false;
+    }
+    return true;
+}
+
+/* Whether the summary was fetched within the freshness TTL, and reaches at
+   least as far as the given hour. */
+static bool summary_is_fresh(const StudySummary* q, int32_t hour) {
+    time_t now = time(NULL);
+    if (s_freshness_ttl == 0 || q->fetched_at == 0
+     || now < q->fetched_at || now - q->fetched_at > s_freshness_ttl * kOneMinute) {
+        return false;
+    }
+    return hour <= q->epoch_hour
+        || (q->forecast_length > 0 && hour <= forecast_hour(q, q->forecast_length - 1));
+}
+
 // -----------------------------------------------------------------------------
 // Event Handlers
 // -----------------------------------------------------------------------------
@@ -532,7 +1403,11 @@ void success_auto_close(void* context) {
 }
 
 static void app_ready(void* context) {
-    if (s_launch_reason == APP_LAUNCH_TIMELINE_ACTION
+    if (s_refresh_deferred) {
+        /* The saved summary already answers the pin that launched the app. */
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "Summary is fresh, refresh deferred.");
+
+    } else if (s_launch_reason == APP_LAUNCH_TIMELINE_ACTION
      || s_launch_reason == APP_LAUNCH_QUICK_LAUNCH
      || s_launch_reason == APP_LAUNCH_USER
      || s_launch_reason == APP_LAUNCH_SYSTEM) // The aplite platform always launches with this code.
@@ -548,12 +1423,15 @@ static void app_ready(void* context) {
 
         int value = 1;
         dict_write_int(out_iter, MESSAGE_KEY_REFRESH, &value, sizeof(int), true);
+        dict_write_uint16(out_iter, MESSAGE_KEY_FORECAST_CHUNK, kForecastChunkSize);
         result = app_message_outbox_send();
 
         if (result != APP_MSG_OK) {
             show_error_screen("I've fallen and I can't get up.");
         } else {
             APP_LOG(APP_LOG_LEVEL_DEBUG, "Requested update.");
+            s_refresh_ms = now_ms();
+            s_perf.launch_to_refresh_ms = s_refresh_ms - s_launch_ms;
         }
 
     } else {
@@ -564,32 +1442,36 @@ static void app_ready(void* context) {
 
 }
 
+/* The phone did not answer.  A saved summary on display stays there, marked
+   as offline; without one, there is nothing to show but the error. */
 static void app_timeout(void* context) {
-    strncpy(s_message_text_buffer, "Host unavailable.", sizeof s_message_text_buffer);
-    window_set_background_color(s_message_screen, GColorFolly);
-    s_message_text_color = GColorWhite;
-    window_stack_push(s_message_screen, true);
-    window_stack_remove(s_load_screen, false);
+    if (s_refresh_deferred) {
+        return;
+    }
+    if (window_stack_contains_window(s_main_screen)) {
+        set_offline(true);
+    } else {
+        show_error_screen("Host unavailable.");
+    }
 }
 
 #if PBL_API_EXISTS(app_glance_reload)
 
 static const char* glance_slice_subtitle(int lessons, int reviews) {
-    snprintf(s_scratch_text_buffer, ARRAY_LENGTH(s_scratch_text_buffer),
-        "L:%d R:%d", lessons, reviews);
-    return s_scratch_text_buffer;
+    static char subtitle[64];
+    snprintf(subtitle, ARRAY_LENGTH(subtitle), "L:%d R:%d", lessons, reviews);
+    return subtitle;
 }
 
 static void refresh_app_glance(AppGlanceReloadSession* session, size_t limit, void* context) {
 
     StudySummary* q = (StudySummary*)context;
-    int base_epoch_hour = q->epoch_hour;
     uint16_t review_count = q->review_count;
 
     /* We will create one slice for the currently available reviews, and one
        slice for each upcoming review in the schedule, but limit the total
        slices as indicated by the system. */
-    size_t slice_count = 1 + q->forecast_length / 2;
+    size_t slice_count = 1 + q->forecast_length;
     if (slice_count > limit) {
         slice_count = limit;
     }
@@ -600,9 +1482,8 @@ static void refresh_app_glance(AppGlanceReloadSession* session, size_t limit, vo
     slice.expiration_time = APP_GLANCE_SLICE_NO_EXPIRATION;
 
     for (size_t k = 0; k < slice_count - 1; ++k) {
-        int epoch_hour = q->forecast[k * 2];
-        int item_count = q->forecast[k * 2 + 1];
-        slice.expiration_time = (base_epoch_hour + epoch_hour) * kOneHour;
+        int item_count = forecast_entry(q, k)->count;
+        slice.expiration_time = forecast_hour(q, k) * kOneHour;
         const AppGlanceResult result = app_glance_add_slice(session, slice);
         if (result != APP_GLANCE_RESULT_SUCCESS) {
             APP_LOG(APP_LOG_LEVEL_ERROR, "AppGlance Error: %d", result);
@@ -622,10 +1503,125 @@ static void refresh_app_glance(AppGlanceReloadSession* session, size_t limit, vo
 
 #endif // PBL_API_EXISTS(app_glance_reload)
 
+/* REVIEW_FORECAST wire format, version 2:
+
+     byte 0     format version
+     byte 1     flags; kForecastAppend continues the forecast of the previous
+                message instead of replacing it.
+     byte 2...  the epoch hour that the chunk's first entry counts from, as
+                an unsigned LEB128 varint.  For the first chunk it is
+                EPOCH_HOUR, and for the others the hour of the last entry of
+                the chunk before.
+     then       one entry after another, each a pair of varints: the hours
+                since the previous entry, and the subject count.
+
+   A forecast too large for one message is split at entry boundaries over
+   several messages, all but the first carrying kForecastAppend.  Each chunk
+   carries its own base hour, because the summary may be aged between two
+   chunks, and aging can expire every entry that an appended chunk would
+   otherwise count from. */
+
+static const uint8_t kForecastFormatVersion = 2;
+static const uint8_t kForecastAppend = 0x01;
+
+static const uint8_t* read_varint(const uint8_t* p, const uint8_t* end, uint32_t* value) {
+    uint32_t v = 0;
+    for (int shift = 0; p < end && shift < 32; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *value = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* Read one forecast entry.  Counts are kept as uint16, so a larger one is
+   malformed. */
+static const uint8_t* read_forecast_entry(const uint8_t* p, const uint8_t* end, uint32_t* hours, uint32_t* count) {
+    p = read_varint(p, end, hours);
+    p = p ? read_varint(p, end, count) : NULL;
+    return p && *count <= UINT16_MAX ? p : NULL;
+}
+
+static bool decode_forecast(StudySummary* q, const uint8_t* data, uint16_t length) {
+    if (length < 2 || data[0] != kForecastFormatVersion) {
+        return false;
+    }
+    bool append = (data[1] & kForecastAppend) != 0;
+    const uint8_t* end = data + length;
+    uint32_t base_hour, hours = 0, count = 0;
+    const uint8_t* begin = read_varint(data + 2, end, &base_hour);
+    if (!begin || base_hour > INT32_MAX) {
+        return false;
+    }
+
+    /* Read the whole chunk through before changing the forecast, so that a
+       malformed chunk leaves it as it was. */
+    for (const uint8_t* p = begin; p < end; ) {
+        p = read_forecast_entry(p, end, &hours, &count);
+        if (!p) {
+            return false;
+        }
+    }
+
+    if (!append) {
+        forecast_clear(q);
+    }
+
+    int32_t hour = base_hour;
+    for (const uint8_t* p = begin; p < end; ) {
+        p = read_forecast_entry(p, end, &hours, &count);
+        hour += hours;
+        if (!forecast_push(q, hour, count)) {
+            APP_LOG(APP_LOG_LEVEL_WARNING, "Forecast truncated at %d entries.", q->forecast_length);
+            break;
+        }
+    }
+    return true;
+}
+
+/* The saved summary can arrive while the refresh request is still waiting
+   for its acknowledgement, so the counters wait for the outbox to be free
+   rather than fail with APP_MSG_BUSY. */
+static void send_diagnostics() {
+    DictionaryIterator* out_iter;
+    AppMessageResult result = app_message_outbox_begin(&out_iter);
+    s_diagnostics_pending = result == APP_MSG_BUSY;
+    if (result != APP_MSG_OK) {
+        if (!s_diagnostics_pending) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "Error preparing the outbox: %d", (int)result);
+        }
+        return;
+    }
+    dict_write_data(out_iter, MESSAGE_KEY_DIAGNOSTICS, (const uint8_t*)&s_perf, sizeof s_perf);
+    app_message_outbox_send();
+}
+
+static void message_sent(DictionaryIterator* sent, void* context) {
+    if (s_diagnostics_pending) {
+        send_diagnostics();
+    }
+}
+
+static void message_failed(DictionaryIterator* failed, AppMessageResult reason, void* context) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Message not delivered: %d", (int)reason);
+    message_sent(failed, context);
+}
+
 static void message_received(DictionaryIterator* received, void* context) {
 
     StudySummary* q = &s_summary;
 
+    /* Count the dictionary as it was sent: a header byte, and a header plus
+       the value for each tuple. */
+    s_perf.inbox_bytes += 1;
+    for (Tuple* tuple = dict_read_first(received); tuple; tuple = dict_read_next(received)) {
+        s_perf.inbox_bytes += sizeof(Tuple) + tuple->length;
+    }
+    perf_sample_heap();
+
     Tuple* t = dict_find(received, MESSAGE_KEY_CONFIGURE);
     if (t) {
         if (t->type == TUPLE_CSTRING) {
@@ -647,7 +1643,10 @@ static void message_received(DictionaryIterator* received, void* context) {
         strncpy(s_loading_text_buffer, t->value->cstring, sizeof s_loading_text_buffer);
         layer_mark_dirty(window_get_root_layer(s_load_screen));
         window_stack_remove(s_message_screen, true);
-        if (!window_stack_contains_window(s_load_screen)) {
+        /* A previously saved summary may already be on display, in which case
+           the refresh carries on behind it. */
+        if (!window_stack_contains_window(s_main_screen)
+         && !window_stack_contains_window(s_load_screen)) {
             window_stack_push(s_load_screen, true);
         }
     }
@@ -656,6 +1655,16 @@ static void message_received(DictionaryIterator* received, void* context) {
     if (t && t->type == TUPLE_INT) {
         q->epoch_hour = t->value->int32;
     }
+
+    t = dict_find(received, MESSAGE_KEY_FETCHED_AT);
+    if (t && t->type == TUPLE_INT) {
+        q->fetched_at = t->value->int32;
+    }
+
+    t = dict_find(received, MESSAGE_KEY_FRESHNESS_TTL);
+    if (t && t->type == TUPLE_INT) {
+        s_freshness_ttl = t->value->int32;
+    }
     
     t = dict_find(received, MESSAGE_KEY_LESSON_COUNT);
     if (t && t->type == TUPLE_INT) {
@@ -669,13 +1678,59 @@ static void message_received(DictionaryIterator* received, void* context) {
     
     t = dict_find(received, MESSAGE_KEY_REVIEW_FORECAST);
     if (t && t->type == TUPLE_BYTE_ARRAY) {
-        q->forecast_length = t->length;
-        q->forecast = realloc(q->forecast, t->length);
-        memcpy(q->forecast, t->value->data, t->length);
+        if (!decode_forecast(q, t->value->data, t->length)) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "Malformed forecast of %u bytes.", t->length);
+        }
+    }
+
+    /* SRS_COUNTS holds the count of each group of SRS stages, as
+       little-endian uint16.  LEVEL_PROGRESS holds the level, and the passed
+       and total kanji of the level, a byte each; a level of zero clears the
+       progress. */
+    bool progress_changed = false;
+    t = dict_find(received, MESSAGE_KEY_SRS_COUNTS);
+    if (t && t->type == TUPLE_BYTE_ARRAY && t->length == 2 * kSrsStageGroups) {
+        for (int k = 0; k < kSrsStageGroups; ++k) {
+            s_progress.stage_counts[k] = t->value->data[2 * k] | (t->value->data[2 * k + 1] << 8);
+        }
+        progress_changed = true;
+    }
+
+    t = dict_find(received, MESSAGE_KEY_LEVEL_PROGRESS);
+    if (t && t->type == TUPLE_BYTE_ARRAY && t->length == 3) {
+        if (t->value->data[0] == 0) {
+            memset(&s_progress, 0, sizeof s_progress);
+            if (s_forecast_view == kForecastViewStages) {
+                s_forecast_view = kForecastViewRows;
+                mark_layer_dirty(s_forecast_layer);
+            }
+        } else {
+            s_progress.level = t->value->data[0];
+            s_progress.level_passed = t->value->data[1];
+            s_progress.level_total = t->value->data[2];
+        }
+        progress_changed = true;
+    }
+
+    if (progress_changed) {
+        save_progress(&s_progress);
+        cache_stage_rows(&s_progress);
     }
 
     t = dict_find(received, MESSAGE_KEY_SUCCESS);
     if (t && t->type == TUPLE_INT && t->value->int32 != 0) {
+        save_summary(&s_summary);
+        cache_study_summary(&s_summary);
+        schedule_refresh(&s_summary);
+        set_offline(false);
+        if (!s_first_success_logged) {
+            s_first_success_logged = true;
+            log_heap_usage("after first success");
+        }
+        if (s_refresh_ms) {
+            s_perf.refresh_to_success_ms = now_ms() - s_refresh_ms;
+        }
+        send_diagnostics();
 #if PBL_API_EXISTS(app_glance_reload)
         app_glance_reload(refresh_app_glance, &s_summary);
 #endif
@@ -699,7 +1754,9 @@ static void message_received(DictionaryIterator* received, void* context) {
 
 int main() {
 
-    init_fonts();
+    s_launch_ms = now_ms();
+
+    init_text_attributes();
 
     strncpy(s_loading_text_buffer, kLoadScreenDefaultText, sizeof s_loading_text_buffer);
     memset(&s_summary, 0, sizeof s_summary);
@@ -721,20 +1778,62 @@ int main() {
     s_load_screen = create_loading_screen();
     s_message_screen = create_message_screen();
 
-    window_stack_push(s_load_screen, true);
+    if (load_progress(&s_progress)) {
+        cache_stage_rows(&s_progress);
+    }
+
+    /* Show the last known summary right away, if there is one, while the
+       phone fetches a fresh one. */
+    if (load_summary(&s_summary)) {
+        update_schedule(&s_summary);
+        window_stack_push(s_main_screen, false);
+        /* A pin passes its epoch hour as the launch code.  If the saved
+           summary is fresh and covers that hour, there is nothing to fetch. */
+        if (s_launch_reason == APP_LAUNCH_TIMELINE_ACTION) {
+            s_refresh_deferred = summary_is_fresh(&s_summary, launch_get_args());
+        }
+    } else {
+        window_stack_push(s_load_screen, true);
+    }
 
     app_ready_service_subscribe((AppReadyHandlers){
         .ready = app_ready,
         .timeout = app_timeout
     }, NULL);
 
-    events_app_message_request_inbox_size(1024);
-    events_app_message_request_outbox_size(32);
+    /* The largest inbound message is either a summary, with its six
+       integers and a forecast chunk, which the phone always sends on its
+       own, or the notices that the phone merges while another message is in
+       flight: the progress and configuration texts and the study progress.
+       The outbound messages are the refresh request and the diagnostics. */
+    uint32_t summary_size = dict_calc_buffer_size(7,
+        sizeof(int32_t), sizeof(int32_t), sizeof(int32_t), sizeof(int32_t),
+        sizeof(int32_t), sizeof(int32_t), kForecastChunkSize);
+    uint32_t notices_size = dict_calc_buffer_size(4,
+        sizeof s_loading_text_buffer, sizeof s_message_text_buffer, 2 * kSrsStageGroups, 3);
+    events_app_message_request_inbox_size(summary_size > notices_size ? summary_size : notices_size);
+    events_app_message_request_outbox_size(dict_calc_buffer_size(2,
+        sizeof(int), sizeof(uint16_t)));
+    events_app_message_request_outbox_size(dict_calc_buffer_size(1,
+        sizeof(PerfCounters)));
     s_app_message_event_handle = events_app_message_register_inbox_received(&message_received, NULL);
+    events_app_message_register_outbox_sent(&message_sent, NULL);
+    events_app_message_register_outbox_failed(&message_failed, NULL);
     events_app_message_open();
+    log_heap_usage("at launch");
 
     app_event_loop();
 
+#if PBL_API_EXISTS(app_glance_reload)
+    /* The glance has a slice for each forecast hour, but the system limits
+       the number of slices.  Rebuilding it from the aged summary on the way
+       out extends it past the slices that have already expired. */
+    if (s_summary.epoch_hour != 0) {
+        age_summary(&s_summary);
+        app_glance_reload(refresh_app_glance, &s_summary);
+    }
+#endif
+
     window_destroy(s_load_screen);
     window_destroy(s_message_screen);
     window_destroy(s_main_screen);
@@ -22,6 +22,45 @@ module.exports = [
                 description: 'Your WaniKani v2 API token.',
                 attributes: {
                 }
+            },
+            {
+                type: 'input',
+                messageKey: 'API_TOKEN_2',
+                label: 'Second Personal Access Token',
+                defaultValue: '',
+                description: 'Optional.  The forecasts of all accounts are added together on the watch, and each account gets its own pins.',
+                attributes: {
+                }
+            },
+            {
+                type: 'input',
+                messageKey: 'API_TOKEN_3',
+                label: 'Third Personal Access Token',
+                defaultValue: '',
+                description: 'Optional.',
+                attributes: {
+                }
+            },
+            {
+                type: 'select',
+                messageKey: 'FRESHNESS_TTL',
+                label: 'Reuse Schedule From Pins',
+                defaultValue: '30',
+                description: 'When opened from a timeline pin, show the saved schedule without refreshing it if it was fetched within this time.',
+                options: [
+                    { label: 'Never', value: '0' },
+                    { label: 'For 15 minutes', value: '15' },
+                    { label: 'For 30 minutes', value: '30' },
+                    { label: 'For 1 hour', value: '60' },
+                    { label: 'For 2 hours', value: '120' }
+                ]
+            },
+            {
+                type: 'toggle',
+                messageKey: 'SYNC_ASSIGNMENTS',
+                label: 'Show SRS Stages',
+                defaultValue: false,
+                description: 'Keep a copy of your assignments on the phone, to show how many items are at each SRS stage, and your kanji progress on your current level.  The first sync downloads every assignment; later ones only what has changed.'
             }
         ]
     },
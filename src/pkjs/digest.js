@@ -0,0 +1,15 @@
+(function() {
+    'use strict';
+
+    /* A short, stable digest of a string (djb2), as hex.  It is used for
+       cache keys and to tell whether content has changed, not for security. */
+    function digest(text) {
+        var hash = 5381;
+        for (var k = 0; k < text.length; ++k) {
+            hash = ((hash * 33) ^ text.charCodeAt(k)) | 0;
+        }
+        return (hash >>> 0).toString(16);
+    }
+
+    module.exports = digest;
+}());
@@ -2,9 +2,9 @@
 /*eslint no-unused-vars: ["error", { "argsIgnorePattern": "^_" }]*/
 /*global Pebble */
 
-var userName,
-    wanikaniSummary,
-    timelinePins = [];
+var wanikaniSummary,
+    timelinePins = {},
+    forecastChunkBytes;
 
 var Clay = require('pebble-clay');
 var clayConfig = require('./config.js');
@@ -13,9 +13,10 @@ var messageKeys = require('message_keys');
 var _ = require('underscore');
 
 var Jobber = require('./jobber.js');
-var jobber = new Jobber();
+var jobber = new Jobber(terminateWithError);
 
 var WaniKani = require('./wanikani.js');
+var digest = require('./digest.js');
 var AppReadyService = require('./pebble-app-ready-service.js');
 
 /* Polyfill */
@@ -36,18 +37,52 @@ AppReadyService.ready(function () {
     console.log('Ready.');
     timelinePins = loadObject('timeline_pins', timelinePins);
     console.log('Loaded timelinePins ' + JSON.stringify(timelinePins, null, 2));
+
+    /* Send the last good summary straight away, so the watch has something
+       to show while it asks for a refresh. */
+    var cachedSummary = loadObject('wanikani_summary', null);
+    if (loadAccounts().length && cachedSummary) {
+        console.log('Send cached summary.');
+        wanikaniSummary = ageSummary(cachedSummary);
+        sendStudySummary(true);
+    }
 });
 
+/* The names of the DIAGNOSTICS counters, in the order of the PerfCounters
+ * struct in main.c. */
+var DIAGNOSTICS_COUNTERS = [
+    'redrawCount',
+    'redrawMsTotal',
+    'redrawMsMax',
+    'launchToRefreshMs',
+    'refreshToSuccessMs',
+    'inboxBytes',
+    'heapFreeMin'
+];
+
+function logDiagnostics(bytes) {
+    var counters = {};
+    _.each(DIAGNOSTICS_COUNTERS, function (name, index) {
+        var k = index * 4;
+        counters[name] = (bytes[k] | (bytes[k + 1] << 8) | (bytes[k + 2] << 16) | (bytes[k + 3] << 24)) >>> 0;
+    });
+    console.log('Watch diagnostics ' + Pebble.getActiveWatchInfo().model + ': ' + JSON.stringify(counters));
+}
+
 Pebble.addEventListener('appmessage', function (event) {
 
+    if (event.payload.DIAGNOSTICS) {
+        logDiagnostics(event.payload.DIAGNOSTICS);
+    }
+
     if (event.payload.REFRESH) {
         console.log('Watch has requested study schedule update.');
+        forecastChunkBytes = event.payload.FORECAST_CHUNK;
 
-        var settings = JSON.parse(localStorage.getItem('clay-settings')) || {};
+        var accounts = loadAccounts();
 
-        if (_.has(settings, 'API_TOKEN')) {
-            var wanikani = new WaniKani(settings['API_TOKEN']);
-            fetchStudyQueue(wanikani);
+        if (accounts.length) {
+            fetchStudyQueue(accounts);
         } else {
             var message = {
                 'CONFIGURE': 'Please provide your Personal Access Token in settings.'
@@ -63,64 +98,105 @@ Pebble.addEventListener('appmessage', function (event) {
 
 });
 
+/* The settings keys of the WaniKani tokens, one for each account. */
+var API_TOKEN_KEYS = ['API_TOKEN', 'API_TOKEN_2', 'API_TOKEN_3'];
+
+/* Make an account for each distinct token in the settings.  The user name
+ * of each account is filled in by the refresh. */
+function loadAccounts() {
+    var settings = JSON.parse(localStorage.getItem('clay-settings')) || {},
+        tokens = _.uniq(_.compact(_.map(API_TOKEN_KEYS, function (key) {
+            return settings[key] && settings[key].trim();
+        })));
+    return _.map(tokens, function (token) {
+        return { wanikani: new WaniKani(token), userName: null, summary: null };
+    });
+}
+
 function enqueProgressReport(type, text) {
     var message = {};
     message[type] = text;
-    jobber.enqueMessage(message, 'Report ' + type + ': ' + text);
+    jobber.enqueNotice(message, 'Report ' + type + ': ' + text);
 }
 
-function fetchStudyQueue(wanikani) {
+/* The user name is needed only to name the pins, and hardly ever changes, so
+ * the user endpoint is not even revalidated while the cached one is fresh. */
+var USER_MAX_AGE = 24 * 60 * 60 * 1000;
 
-    var onWaniKaniError = function(error) {
-        jobber.cancelAllJobs();
-        terminateWithError(error.message);
-    }
+function fetchStudyQueue(accounts) {
 
-    enqueProgressReport('PROGRESS', 'Consulting the Crabigator');
-    jobber.enqueJob(function (_next, _abort) { wanikani.request('user', receiveUser, onWaniKaniError); });
+    /* The user and the summary of each account, and the timeline token, do
+       not depend on each other, so they are fetched all at once.  Each one is
+       retried on its own, so a failure does not fetch the others again, and
+       only the first failure that outlasts its retries is reported. */
+    var timelineToken;
+    var fetchJobs = [];
+    _.each(accounts, function (account) {
+        fetchJobs.push(jobber.retrying(function (next, abort) {
+            account.wanikani.request('user', function (user) {
+                receiveUser(account, user);
+                next();
+            }, abort, USER_MAX_AGE);
+        }));
+        fetchJobs.push(jobber.retrying(function (next, abort) {
+            account.wanikani.request('summary', function (summary) {
+                receiveSummary(account, summary);
+                next();
+            }, abort);
+        }));
+    });
 
-    enqueProgressReport('PROGRESS', 'Receiving the Summary');
-    jobber.enqueJob(function (_next, _abort) { wanikani.request('summary', receiveSummary, onWaniKaniError); });
+    var syncing = syncAssignmentsEnabled();
+    if (syncing) {
+        _.each(accounts, function (account) {
+            fetchJobs.push(jobber.retrying(function (next, abort) {
+                account.wanikani.sync('assignments', reduceAssignment, function (records) {
+                    account.assignments = records;
+                    next();
+                }, abort);
+            }));
+        });
+    }
 
-    var timelineToken;
     if (Pebble.getActiveWatchInfo().model.startsWith('qemu')) {
-        jobber.enqueJob(function(next, _abort) {
-            console.warn('Emulator cannot access timeline token.');
-            next();
-        });
+        console.warn('Emulator cannot access timeline token.');
     } else {
-        enqueProgressReport('PROGRESS', 'Altering the Timeline');
-        jobber.enqueJob(function (next, abort) {
+        fetchJobs.push(jobber.retrying(function (next, abort) {
             Pebble.getTimelineToken(function (token) {
                 console.log('Aquired timeline token: ' + token);
                 timelineToken = token;
                 next();
             }, function (error) {
-                abort();
                 console.error(error);
-                terminateWithError('Could not access timeline token.');
+                abort('Could not access timeline token.', true);
             });
-        });
+        }));
     }
 
+    enqueProgressReport('PROGRESS', 'Consulting the Crabigator');
+    jobber.enqueGroup(fetchJobs, fetchJobs.length);
+
     enqueProgressReport('PROGRESS', 'Pushing the Pins');
     jobber.enqueJob(function (next, _abort) {
         /* This job just enqueues more jobs, but it needs the above jobs to
-           complete before it has the data to work from. */        
-        pushReviewPins(timelineToken); /* enqueues several jobs */
-        sendStudySummary(); /* enqueues one job */
+           complete before it has the data to work from.  The summary goes to
+           the watch first, so that it need not wait for the pins. */
+        mergeSummaries(accounts);
+        sendStudySummary(); /* enqueues one or more jobs */
+        sendStudyProgress(accounts, syncing); /* enqueues a few jobs */
+        pushReviewPins(timelineToken, accounts); /* enqueues several jobs */
         next();
     });
 
     jobber.start();
 }
 
-function receiveUser(user) {
-    userName = user.username;
-    jobber.dequeNextJob();
+function receiveUser(account, user) {
+    account.userName = user.username;
+    account.level = user.level;
 }
 
-function receiveSummary(summary) {
+function receiveSummary(account, summary) {
 
     var msecPerHour = 1000 * 60 * 60;
     var reviews = _.map(summary.reviews, function (entry) { return {
@@ -130,148 +206,381 @@ function receiveSummary(summary) {
     reviews = _.filter(reviews, function (entry) {
         return entry.subjectCount > 0;
     });
+
+    account.summary = ageSummary({
+        lessons: summary.lessons[0].subject_ids.length,
+        reviews: reviews,
+        fetchedAt: Math.floor(Date.now() / 1000)
+    });
+}
+
+/* Combine the summaries of all the accounts into the one that is sent to
+ * the watch, adding up the lessons, and the reviews of each hour. */
+function mergeSummaries(accounts) {
+    var lessons = 0,
+        counts = {},
+        fetchedAt = null;
+
+    _.each(accounts, function (account) {
+        lessons += account.summary.lessons;
+        _.each(account.summary.reviews, function (entry) {
+            counts[entry.epochHour] = (counts[entry.epochHour] || 0) + entry.subjectCount;
+        });
+        if (fetchedAt === null || account.summary.fetchedAt < fetchedAt) {
+            fetchedAt = account.summary.fetchedAt;
+        }
+    });
+
+    var reviews = _.sortBy(_.map(counts, function (subjectCount, epochHour) {
+        return { epochHour: Number(epochHour), subjectCount: subjectCount };
+    }), 'epochHour');
+
+    wanikaniSummary = ageSummary({
+        lessons: lessons,
+        reviews: reviews,
+        fetchedAt: fetchedAt
+    });
+    saveObject('wanikani_summary', wanikaniSummary);
+    console.log(JSON.stringify(wanikaniSummary, null, 2));
+}
+
+/* Return the summary as of the current hour: the first review entry is for
+ * the current hour, and holds every review that is available by then, even
+ * if that is none. */
+function ageSummary(summary) {
+    var msecPerHour = 1000 * 60 * 60,
+        epochHour = Math.floor(Date.now() / msecPerHour),
+        current = { epochHour: epochHour, subjectCount: 0 },
+        reviews = [current];
+
+    _.each(summary.reviews, function (entry) {
+        if (entry.epochHour <= epochHour) {
+            current.subjectCount += entry.subjectCount;
+        } else {
+            reviews.push({ epochHour: entry.epochHour, subjectCount: entry.subjectCount });
+        }
+    });
+
     reviews[0].subjectTotal = reviews[0].subjectCount;
     for (var k = 1; k < reviews.length; ++k) {
         reviews[k].subjectTotal = reviews[k - 1].subjectTotal + reviews[k].subjectCount;
     }
 
-    wanikaniSummary = {
-        lessons: summary.lessons[0].subject_ids.length,
-        reviews: reviews
+    return {
+        lessons: summary.lessons,
+        reviews: reviews,
+        fetchedAt: summary.fetchedAt
     };
-    console.log(JSON.stringify(wanikaniSummary, null, 2));
+}
 
-    jobber.dequeNextJob();
+/* REVIEW_FORECAST wire format; see decode_forecast() in main.c.  Each entry
+ * is a pair of unsigned LEB128 varints, the hours since the previous entry
+ * and the subject count, following a header of format version, flags, and
+ * the epoch hour that the first entry counts from, as a varint.  The watch
+ * reports its chunk size with REFRESH; the default is the smallest of them,
+ * for refreshes that the watch did not request. */
+var FORECAST_FORMAT_VERSION = 2,
+    FORECAST_APPEND = 0x01,
+    FORECAST_MAX_COUNT = 0xffff, // the watch keeps counts as uint16.
+    DEFAULT_FORECAST_CHUNK_BYTES = 128;
+
+function pushVarint(bytes, value) {
+    while (value >= 0x80) {
+        bytes.push((value & 0x7f) | 0x80);
+        value = Math.floor(value / 0x80);
+    }
+    bytes.push(value);
 }
 
-function sendStudySummary() {
+function forecastChunkHeader(append, baseHour) {
+    var header = [FORECAST_FORMAT_VERSION, append ? FORECAST_APPEND : 0];
+    pushVarint(header, baseHour);
+    return header;
+}
+
+/* Encode the forecast entries into one or more chunks, none of which exceed
+ * the chunk byte limit.  Chunks are split only at entry boundaries, and each
+ * one starts from the hour of the entry before it. */
+function encodeForecast(entries, baseEpochHour, chunkBytes) {
+    var chunks = [],
+        chunk = null,
+        previousHour = baseEpochHour;
+    _.each(entries, function (entry) {
+        var bytes = [];
+        pushVarint(bytes, entry.epochHour - previousHour);
+        pushVarint(bytes, Math.min(entry.subjectCount, FORECAST_MAX_COUNT));
+        if (chunk === null || chunk.length + bytes.length > chunkBytes) {
+            chunk = forecastChunkHeader(chunks.length > 0, previousHour);
+            chunks.push(chunk);
+        }
+        Array.prototype.push.apply(chunk, bytes);
+        previousHour = entry.epochHour;
+    });
+    if (chunks.length === 0) {
+        chunks.push(forecastChunkHeader(false, baseEpochHour));
+    }
+    return chunks;
+}
+
+/* Send the summary to the watch, as one or more forecast chunks.  A fresh
+ * summary is enqueued, so that the jobs after it wait for the watch to take
+ * it.  The cached one is posted straight to the outbox instead: if the watch
+ * rejects it, the refresh jobs queued behind it must still run, so its
+ * failure is only logged. */
+function sendStudySummary(cached) {
     'use strict';
-    var schedule = [],
-        baseEpochHour = wanikaniSummary.reviews[0].epochHour,
-        message = {
-            'SUCCESS': true,
-            'EPOCH_HOUR': baseEpochHour,
-            'LESSON_COUNT': wanikaniSummary.lessons,
-            'REVIEW_COUNT': wanikaniSummary.reviews[0].subjectCount,
-            'REVIEW_FORECAST': schedule
-        };
-    _.each(wanikaniSummary.reviews.slice(1), function (entry) {
-        if (entry.subjectCount) {
-            schedule.push(entry.epochHour - baseEpochHour);
-            schedule.push(Math.min(255, entry.subjectCount));
+    var baseEpochHour = wanikaniSummary.reviews[0].epochHour,
+        entries = _.filter(wanikaniSummary.reviews.slice(1), function (entry) {
+            return entry.subjectCount;
+        }),
+        chunks = encodeForecast(entries, baseEpochHour,
+            forecastChunkBytes || DEFAULT_FORECAST_CHUNK_BYTES);
+
+    _.each(chunks, function (chunk, index) {
+        var message = { 'REVIEW_FORECAST': chunk };
+        if (index === 0) {
+            message['EPOCH_HOUR'] = baseEpochHour;
+            message['LESSON_COUNT'] = wanikaniSummary.lessons;
+            message['REVIEW_COUNT'] = wanikaniSummary.reviews[0].subjectCount;
+            message['FETCHED_AT'] = wanikaniSummary.fetchedAt || 0;
+            message['FRESHNESS_TTL'] = freshnessTtl();
+        }
+        if (index === chunks.length - 1) {
+            message['SUCCESS'] = true;
+        }
+        /* The watch's inbox has room for one forecast chunk with the summary
+           counts, but not for notices merged in as well. */
+        if (cached) {
+            console.log('post: ' + JSON.stringify(message, null, 2));
+            jobber.postMessage(message, null, null, true);
+        } else {
+            jobber.enqueMessage(message, 'send: ' + JSON.stringify(message, null, 2), true);
         }
     });
-    jobber.enqueMessage(message, 'send: ' + JSON.stringify(message, null, 2));
 }
 
-/* This function enqueues a number of jobs.
- */
-function pushReviewPins(timelineToken) {
+/* The freshness TTL in minutes, from the settings.  The watch skips the
+ * refresh when opened from a pin while the summary is younger than this. */
+var DEFAULT_FRESHNESS_TTL = 30;
+
+function freshnessTtl() {
+    var settings = JSON.parse(localStorage.getItem('clay-settings')) || {},
+        ttl = parseInt(settings['FRESHNESS_TTL'], 10);
+    return isNaN(ttl) ? DEFAULT_FRESHNESS_TTL : ttl;
+}
+
+function syncAssignmentsEnabled() {
+    var settings = JSON.parse(localStorage.getItem('clay-settings')) || {};
+    return settings['SYNC_ASSIGNMENTS'] === true;
+}
+
+/* An assignment is kept as its subject id and SRS stage.  Hidden
+ * assignments are dropped. */
+function reduceAssignment(resource) {
+    var assignment = resource.data;
+    return assignment.hidden ? null : [assignment.subject_id, assignment.srs_stage];
+}
 
-    /* Enque a pin job for each current schedule entry. */
-    _.each(wanikaniSummary.reviews, function (entry) {
+/* The SRS stages, 1 to 9, are counted in the five groups that WaniKani
+ * shows: Apprentice, Guru, Master, Enlightened and Burned.  An item is
+ * passed once it reaches Guru. */
+var SRS_STAGE_GROUPS = [0, 0, 0, 0, 0, 1, 1, 2, 3, 4],
+    SRS_PASSED_STAGE = 5,
+    SUBJECTS_MAX_AGE = 7 * 24 * 60 * 60 * 1000;
+
+/* SRS_COUNTS wire format: the five group counts, as little-endian uint16.
+ * LEVEL_PROGRESS: the level, the passed kanji of the level, and all the
+ * kanji of the level, one byte each.  A level of zero clears the progress
+ * on the watch. */
+function encodeUint16s(values) {
+    var bytes = [];
+    _.each(values, function (value) {
+        value = Math.min(value, 0xffff);
+        bytes.push(value & 0xff, value >> 8);
+    });
+    return bytes;
+}
 
-        var isoTime = new Date(entry.epochHour * 60 * 60 * 1000).toISOString(),
-            subTitle = (entry.subjectCount == entry.subjectTotal) ?
-                entry.subjectTotal + ' items.' :
-                entry.subjectTotal + ' items (' + entry.subjectCount + ' new)',
-        pin = {
-            id: userName + '@' + entry.epochHour,
+/* This function enqueues the jobs to look up the kanji of each account's
+ * level, which hardly ever change and so are cached for a week, followed by
+ * a job that counts the synced assignments and sends the counts to the
+ * watch.  The SRS counts are for all the accounts together; the level
+ * progress is for the first account. */
+function sendStudyProgress(accounts, syncing) {
+
+    if (!syncing) {
+        /* Clear the progress from the watch if the sync has been turned off. */
+        if (loadObject('wanikani_progress', null)) {
+            window.localStorage.removeItem('wanikani_progress');
+            jobber.enqueMessage({ 'LEVEL_PROGRESS': [0, 0, 0] }, 'Clear study progress.');
+        }
+        return;
+    }
+
+    var primary = accounts[0];
+    jobber.enqueJob(jobber.retrying(function (next, abort) {
+        primary.wanikani.request('subjects?types=kanji&levels=' + primary.level, function (subjects) {
+            primary.levelKanji = _.pluck(subjects, 'id');
+            next();
+        }, abort, SUBJECTS_MAX_AGE);
+    }));
+
+    jobber.enqueJob(function (next, abort) {
+        var counts = [0, 0, 0, 0, 0];
+        _.each(accounts, function (account) {
+            _.each(account.assignments, function (record) {
+                if (record[1] > 0) {
+                    counts[SRS_STAGE_GROUPS[record[1]]] += 1;
+                }
+            });
+        });
+
+        var stages = _.object(_.map(primary.assignments, function (record) {
+                return [record[0], record[1]];
+            })),
+            passed = _.filter(primary.levelKanji, function (id) {
+                return stages[id] >= SRS_PASSED_STAGE;
+            }).length,
+            progress = {
+                counts: counts,
+                level: primary.level,
+                passed: passed,
+                total: primary.levelKanji.length
+            };
+
+        saveObject('wanikani_progress', progress);
+        console.log('send progress: ' + JSON.stringify(progress));
+        jobber.postMessage({
+            'SRS_COUNTS': encodeUint16s(progress.counts),
+            'LEVEL_PROGRESS': [progress.level, Math.min(progress.passed, 255), Math.min(progress.total, 255)]
+        }, next, abort);
+    });
+}
+
+/* The number of timeline requests allowed in flight at once. */
+var PIN_CONCURRENCY = 4;
+
+/* When there is more than one account, the pins say whose reviews they are. */
+function makeReviewPin(userName, entry, shared) {
+    var isoTime = new Date(entry.epochHour * 60 * 60 * 1000).toISOString(),
+        subTitle = (entry.subjectCount == entry.subjectTotal) ?
+            entry.subjectTotal + ' items.' :
+            entry.subjectTotal + ' items (' + entry.subjectCount + ' new)',
+    pin = {
+        id: userName + '@' + entry.epochHour,
+        time: isoTime,
+        layout: {
+            type: 'genericPin',
+            title: shared ? 'WaniKani Review: ' + userName : 'WaniKani Review',
+            subtitle: subTitle,
+            tinyIcon: 'system://images/SCHEDULED_EVENT'
+        },
+        actions: [{
+            title: 'Check',
+            type: 'openWatchApp',
+            launchCode: entry.epochHour
+        }]
+    };
+    if (entry.subjectCount != entry.subjectTotal) {
+        pin.reminders = [{
             time: isoTime,
             layout: {
-                type: 'genericPin',
-                title: 'WaniKani Review',
-                subtitle: subTitle,
-                tinyIcon: 'system://images/SCHEDULED_EVENT'
-            },
-            actions: [{
-                title: 'Check',
-                type: 'openWatchApp',
-                launchCode: entry.epochHour
-            }]
-        };
-        if (entry.subjectCount != entry.subjectTotal) {
-            pin.reminders = [{
-                time: isoTime,
-                layout: {
-                    type: 'genericReminder',
-                    tinyIcon: 'system://images/TIMELINE_CALENDAR',
-                    title: entry.subjectTotal + ' reviews are available now.'
-                }
-            }];
-        }
+                type: 'genericReminder',
+                tinyIcon: 'system://images/TIMELINE_CALENDAR',
+                title: entry.subjectTotal + ' reviews are available now.'
+            }
+        }];
+    }
+    return pin;
+}
+
+/* A short, stable digest of the pin content. */
+function hashPin(pin) {
+    return digest(JSON.stringify(pin));
+}
+
+/* The pin records are a map of pin id to the hash of the content last
+ * pushed for it.  Earlier versions kept an array of epoch hours; those pins
+ * are adopted with an empty hash, so they are pushed again or deleted. */
+function migrateTimelinePins(userName) {
+    if (_.isArray(timelinePins)) {
+        timelinePins = _.object(_.map(timelinePins, function (epochHour) {
+            return [userName + '@' + epochHour, ''];
+        }));
+        saveObject('timeline_pins', timelinePins);
+    }
+}
+
+/* This function enqueues a group of pin jobs, run concurrently and retried
+ * on their own.  Only pins that are new or whose content has changed are
+ * pushed, and only pins that are no longer in the schedule are deleted.  The
+ * pin records are saved as each job completes, so a refresh that fails part
+ * way leaves the next one only the remaining pins to push.  Each account has
+ * its own pins, from its own schedule, with ids in the namespace of its user
+ * name.
+ */
+function pushReviewPins(timelineToken, accounts) {
+
+    if (!timelineToken) {
+        return;
+    }
+
+    migrateTimelinePins(accounts[0].userName);
+
+    var pinJobs = [],
+        wanted = {};
 
-        //console.log(JSON.stringify(pin, null, 2));
-
-        /* NOTE(jr) I do not understand why this extra function closure is
-           necessary here to capture each distinct pin.  The pin variable is
-           already function scoped within the forEach iteration function and
-           I don't see how all the jobs can end up referencing the single,
-           "last" pin created. */
-        if (timelineToken) {
-            (function (pin) {
-                jobber.enqueJob(function (next, abort) {
-                    //console.log('Push pin ' + entry.epochHour + ' @' + formatTimeSlot(entry.epochHour));
+    /* Make a pin job for each new or changed schedule entry. */
+    _.each(accounts, function (account) {
+        _.each(account.summary.reviews, function (entry) {
+            if (!entry.subjectCount) {
+                return;
+            }
+            var pin = makeReviewPin(account.userName, entry, accounts.length > 1),
+                hash = hashPin(pin);
+            wanted[pin.id] = true;
+            if (timelinePins[pin.id] !== hash) {
+                pinJobs.push(jobber.retrying(function (next, abort) {
                     timelineRequest(timelineToken, pin, 'PUT', function () {
-                        rememberTimelinePin(entry);
+                        rememberTimelinePin(pin.id, hash, entry);
                         next();
                     }, abort);
-                });
-            })(pin);
-        }
+                }));
+            }
+        });
     });
 
-    /* Queue a pin deletion job for any outdated pins we know about. */
-    var baseEpochHour = wanikaniSummary.reviews[0].epochHour;
-    _.each(timelinePins.slice(), function (epochHour) {
-        if (epochHour > (baseEpochHour + 36)) {
-            var found = timelinePins.indexOf(epochHour);
-            console.log('obliviate ' + epochHour);
-            timelinePins.splice(found, 1);            
-        }
-    });
-    _.each(timelinePins.slice(), function (epochHour) {
-        var pin = { id: userName + '@' + epochHour };
-        if (epochHour < baseEpochHour) {
-            /* See above for notes on this seemingly extraneous closure. */
-            if (timelineToken) {
-                (function (pin) {
-                    jobber.enqueJob(function (next, abort) {
-                        //console.log('Delete pin ' + epochHour + ' @' + formatTimeSlot(epochHour));
-                        timelineRequest(timelineToken, pin, 'DELETE', function () {
-                            forgetTimelinePin(epochHour);
-                            next();
-                        }, abort);
-                    });
-                })(pin);
-            }
+    /* Make a pin deletion job for any pins that are no longer scheduled. */
+    _.each(_.keys(timelinePins), function (id) {
+        if (!wanted[id]) {
+            pinJobs.push(jobber.retrying(function (next, abort) {
+                timelineRequest(timelineToken, { id: id }, 'DELETE', function () {
+                    forgetTimelinePin(id);
+                    next();
+                }, abort);
+            }));
         }
     });
 
-    /* Queue a job to save the timeline pin records after the above cleanup
-     * jobs have completed. */
-    jobber.enqueJob(function (next, _abort) {
-        console.log('Save timeline pins.');
-        saveObject('timeline_pins', timelinePins);
-        next();
-    });
+    console.log('Pins to update: ' + pinJobs.length);
+    jobber.enqueGroup(pinJobs, PIN_CONCURRENCY);
 }
 
-function rememberTimelinePin(entry) {
-    var found = timelinePins.indexOf(entry.epochHour),
-        what = '+' + entry.subjectCount + '=' + entry.subjectTotal + ' @' + formatTimeSlot(entry.epochHour);
-    if (found < 0) {
-        console.log('Remember ' + what);
-        timelinePins.push(entry.epochHour);
+function rememberTimelinePin(id, hash, entry) {
+    var what = '+' + entry.subjectCount + '=' + entry.subjectTotal + ' @' + formatTimeSlot(entry.epochHour);
+    if (_.has(timelinePins, id)) {
+        console.log('Update ' + what);
     } else {
-        console.log('Affirm ' + what);
+        console.log('Remember ' + what);
     }
+    timelinePins[id] = hash;
+    saveObject('timeline_pins', timelinePins);
 }
 
-function forgetTimelinePin(epochHour) {
-    var found = timelinePins.indexOf(epochHour);
-    console.log('Forget ' + formatTimeSlot(epochHour));
-    timelinePins.splice(found, 1);
+function forgetTimelinePin(id) {
+    console.log('Forget ' + id);
+    delete timelinePins[id];
+    saveObject('timeline_pins', timelinePins);
 }
 
 function formatTimeSlot(epochHour) {
@@ -305,7 +614,7 @@ function localDays(date) {
 
 function terminateWithError(errorText) {
     var message = {};
-    message[messageKeys.ERROR] = errorText.substring(0, 128);
+    message[messageKeys.ERROR] = errorText.substring(0, 127);
     Pebble.sendAppMessage(message, function (_data) {
         console.error('Reported error to watch: ' + errorText);
     }, function (_data, _error) {
@@ -338,12 +647,12 @@ Pebble.addEventListener('webviewclosed', function (event) {
     if (event.response && event.response.length) {
         console.log('Receive configuration.');
 
-        var settings = clay.getSettings(event.response),
-            token = settings[messageKeys.API_TOKEN];
+        /* Clay saves the settings to local storage as well. */
+        clay.getSettings(event.response);
 
-        if (token) {
-            var wanikani = new WaniKani(token);
-            fetchStudyQueue(wanikani);
+        var accounts = loadAccounts();
+        if (accounts.length) {
+            fetchStudyQueue(accounts);
         }
     } else {
         console.log('Configuration canceled.');
@@ -389,7 +698,9 @@ var API_URL_ROOT = 'https://timeline-api.rebble.io/';
  * Send a request to the Pebble public web timeline API.
  * @param pin The JSON pin to insert. Must contain 'id' field.
  * @param type The type of request, either PUT or DELETE.
- * @param callback The callback to receive the responseText after the request has completed.
+ * @param next The callback for when the request has completed.
+ * @param abort The callback for when the request has failed, with the error
+ *     text and whether the failure is transient.
  */
 function timelineRequest(timelineToken, pin, type, next, abort) {
     var url = API_URL_ROOT + 'v1/user/pins/' + pin.id;
@@ -401,15 +712,13 @@ function timelineRequest(timelineToken, pin, type, next, abort) {
             //console.log(this.responseText);
             next();
         } else {
-            abort();
             console.error(this.responseText);
-            terminateWithError('Failed to ' + type + ' timeline pin.');
+            abort('Failed to ' + type + ' timeline pin.', this.status === 429 || this.status >= 500);
         }
     };
     xhr.onerror = function () {
-        abort();
         console.error(this.responseText);
-        terminateWithError('Failed to ' + type + ' timeline pin.');
+        abort('Failed to ' + type + ' timeline pin.', true);
     };
     xhr.open(type, url);
 
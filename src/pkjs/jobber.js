@@ -2,12 +2,30 @@
 /*eslint no-unused-vars: ["error", { "argsIgnorePattern": "^_" }]*/
 /*global Pebble */
 
+var _ = require('underscore');
+
 (function() {
     'use strict';
 
-    var Jobber = function() {
+    /* A job is a function of two callbacks: next(), to be called when it
+       completes, and abort(errorText, transient), to be called when it fails.
+       An abort cancels all the jobs, and the error text, if any, is passed
+       to the onAbort function given to the constructor. */
+    var Jobber = function(onAbort) {
         this.jobQueue = [];
         this.activeJob = null;
+        this.onAbort = onAbort;
+        this.generation = 0;
+        this.outbox = [];
+        this.sending = false;
+    };
+
+    /* The retry policy: the number of attempts in all, and the bounds of the
+       delay before each retry, which doubles with each attempt. */
+    var DEFAULT_RETRY_POLICY = {
+        attempts: 4,
+        baseDelay: 1000,
+        maxDelay: 16000
     };
 
     Jobber.prototype = {
@@ -29,36 +47,172 @@
                 self.activeJob = self.jobQueue.shift();
                 self.activeJob(
                     function () { self.dequeNextJob(); }, // next
-                    function () { self.cancelAllJobs(); } // abort
+                    function (errorText) {                // abort
+                        self.cancelAllJobs();
+                        if (errorText && self.onAbort) {
+                            self.onAbort(errorText);
+                        }
+                    }
                 );
             } else {
                 self.activeJob = null;
             }
         },
 
+        /* Enqueue a single job that runs a group of jobs with at most
+           `concurrency` of them in flight at once.  The group completes when
+           all of its jobs have, and aborts as soon as any one of them does,
+           without starting the rest. */
+        enqueGroup: function (jobs, concurrency) {
+            var self = this;
+            self.enqueJob(function (next, abort) {
+                self.runGroup(jobs, concurrency, next, abort);
+            });
+        },
+
+        runGroup: function (jobs, concurrency, next, abort) {
+            var pending = jobs.slice(),
+                running = 0,
+                finished = false;
+
+            var finish = function (callback) {
+                if (!finished) {
+                    finished = true;
+                    callback();
+                }
+            };
+
+            var launch = function () {
+                while (!finished && running < concurrency && pending.length) {
+                    var job = pending.shift();
+                    running += 1;
+                    job(function () {
+                        running -= 1;
+                        launch();
+                    }, function (errorText) {
+                        running -= 1;
+                        finish(function () { abort(errorText); });
+                    });
+                }
+                if (!running && !pending.length) {
+                    finish(next);
+                }
+            };
+
+            launch();
+        },
+
+        /* Wrap a job so that a transient failure runs it again, after an
+           exponential backoff with jitter, until the policy runs out of
+           attempts.  Only then does the failure abort.  Retries that come due
+           after the jobs have been cancelled are dropped. */
+        retrying: function (job, policy) {
+            var self = this;
+            policy = _.defaults(policy || {}, DEFAULT_RETRY_POLICY);
+            return function (next, abort) {
+                var generation = self.generation,
+                    attempt = 0;
+                var run = function () {
+                    job(next, function (errorText, transient) {
+                        attempt += 1;
+                        if (!transient || attempt >= policy.attempts) {
+                            abort(errorText, transient);
+                            return;
+                        }
+                        var delay = Math.min(policy.maxDelay, policy.baseDelay * Math.pow(2, attempt - 1));
+                        delay = delay / 2 + Math.random() * delay / 2;
+                        console.log('Retry in ' + Math.round(delay) + ' ms: ' + errorText);
+                        setTimeout(function () {
+                            if (self.generation === generation) {
+                                run();
+                            }
+                        }, delay);
+                    });
+                };
+                run();
+            };
+        },
+
         cancelAllJobs: function () {
             var self = this;
             self.jobQueue = [];
             self.activeJob = null;
+            self.generation += 1;
+            /* Anything not yet sent is out of date now. */
+            self.outbox = [];
+        },
+
+        /* Only one message is in flight to the watch at a time.  Messages
+           posted while it is in flight are merged into a single pending
+           dictionary, later values replacing earlier ones for the same key,
+           and the callbacks of each are called when the merged message is
+           acknowledged.  A message posted alone, such as one that is already
+           as large as the watch's inbox allows, is never merged with
+           another; it is sent in order after the pending ones. */
+        postMessage: function (message, onSent, onFailed, alone) {
+            var self = this,
+                batch = _.last(self.outbox);
+            if (alone || !batch || batch.alone) {
+                batch = { message: {}, sent: [], failed: [], alone: !!alone };
+                self.outbox.push(batch);
+            }
+            _.extend(batch.message, message);
+            if (onSent) {
+                batch.sent.push(onSent);
+            }
+            if (onFailed) {
+                batch.failed.push(onFailed);
+            }
+            self.flushMessages();
+        },
+
+        flushMessages: function () {
+            var self = this;
+            if (self.sending || !self.outbox.length) {
+                return;
+            }
+            var batch = self.outbox.shift();
+            self.sending = true;
+            Pebble.sendAppMessage(
+                batch.message,
+            function (_data) {
+                self.sending = false;
+                _.each(batch.sent, function (callback) { callback(); });
+                self.flushMessages();
+            }, function (data, error) {
+                console.log('Error sending message to Pebble device: ');
+                console.log('message', JSON.stringify(batch.message));
+                console.log('data: ', JSON.stringify(data));
+                console.log('error: ', JSON.stringify(error));
+                self.sending = false;
+                _.each(batch.failed, function (callback) { callback(); });
+                self.flushMessages();
+            });
         },
 
-        enqueMessage: function (message, log) {
+        /* Enqueue a message that the following jobs must wait for, sent
+           alone if asked. */
+        enqueMessage: function (message, log, alone) {
             var self = this;
             self.enqueJob(function (next, abort) {
                 if (log) {
                     console.log(log);
                 }
-                Pebble.sendAppMessage(
-                    message,
-                function(_data) {
-                    next();
-                }, function(data, error) {
-                    console.log('Error sending message to Pebble device: ');
-                    console.log('message', JSON.stringify(message));
-                    console.log('data: ', JSON.stringify(data));
-                    console.log('error: ', JSON.stringify(error));
-                    abort();
-                });
+                self.postMessage(message, next, abort, alone);
+            });
+        },
+
+        /* Enqueue a message that the following jobs need not wait for, such
+           as a progress report.  If it is still waiting to be sent when the
+           next one is posted, only the newer values are sent. */
+        enqueNotice: function (message, log) {
+            var self = this;
+            self.enqueJob(function (next, _abort) {
+                if (log) {
+                    console.log(log);
+                }
+                self.postMessage(message);
+                next();
             });
         }
 
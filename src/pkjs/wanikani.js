@@ -1,40 +1,260 @@
-
 var _ = require('underscore');
+var digest = require('./digest.js');
 
 (function() {
     'use strict';
 
+    var API_ROOT = 'https://api.wanikani.com/v2/';
+
+    /* Responses are cached in localStorage, per token and endpoint, along
+       with their validators.  A cached response is revalidated with a
+       conditional request, and reused as is when the server answers 304. */
+    var CACHE_PREFIX = 'wanikani_cache:';
+
+    /* WaniKani allows 60 requests per minute for each token.  Requests are
+       scheduled through a token bucket of that size, which refills at the
+       same rate, and which is shared by every WaniKani object for the token.
+       A 429 response empties the bucket until the time the server gives in
+       its RateLimit-Reset header, and the request is then sent again.  These
+       are the only retries for rate limiting: a 429 that outlasts them is
+       reported as a lasting failure, so that the job retries around the
+       request do not multiply them. */
+    var RATE_LIMIT = 60,
+        RATE_LIMIT_PERIOD = 60 * 1000,
+        RATE_LIMIT_RETRIES = 3;
+
+    var buckets = {};
+
+    var TokenBucket = function() {
+        this.tokens = RATE_LIMIT;
+        this.refilled = Date.now();
+        this.pausedUntil = 0;
+        this.queue = [];
+        this.timer = null;
+    };
+
+    TokenBucket.prototype = {
+
+        /* Call send() as soon as the bucket has a request to spare.  Sends
+           are made in the order they are scheduled. */
+        schedule: function (send) {
+            this.queue.push(send);
+            this.drain();
+        },
+
+        pause: function (until) {
+            this.tokens = 0;
+            this.pausedUntil = Math.max(this.pausedUntil, until);
+        },
+
+        drain: function () {
+            var self = this,
+                now = Date.now();
+            if (self.timer) {
+                return;
+            }
+            if (now >= self.pausedUntil) {
+                self.tokens = Math.min(RATE_LIMIT, self.tokens + (now - self.refilled) * RATE_LIMIT / RATE_LIMIT_PERIOD);
+            }
+            self.refilled = now;
+            while (self.queue.length && self.tokens >= 1 && now >= self.pausedUntil) {
+                self.tokens -= 1;
+                self.queue.shift()();
+            }
+            if (self.queue.length) {
+                var wait = Math.max(self.pausedUntil - now, (1 - self.tokens) * RATE_LIMIT_PERIOD / RATE_LIMIT);
+                self.timer = setTimeout(function () {
+                    self.timer = null;
+                    self.drain();
+                }, Math.ceil(wait));
+            }
+        }
+
+    };
+
+    function parseResponse(xhr) {
+        try {
+            return JSON.parse(xhr.responseText);
+        } catch (ex) {
+            return null;
+        }
+    }
+
+    /* Whether a failed response may succeed if retried: server errors.  A
+       429 has already been retried by get(). */
+    function isTransient(xhr) {
+        return xhr.status >= 500;
+    }
+
+    function errorText(xhr, response) {
+        if (response && _.has(response, 'error')) {
+            return response.error.message || String(response.error);
+        }
+        return xhr.status + ' ' + xhr.statusText.toString();
+    }
+
     var WaniKani = function(token) {
+        var key = digest(token);
         this.token = token;
+        this.cachePrefix = CACHE_PREFIX + key + ':';
+        if (!buckets[key]) {
+            buckets[key] = new TokenBucket();
+        }
+        this.bucket = buckets[key];
     };
 
     WaniKani.prototype = {
 
-        request: function (endpoint, onData, onError) {
-            var url = 'https://api.wanikani.com/v2/' + endpoint,
-                xhr = new XMLHttpRequest();
-            
-            xhr.onload = function () {
-                var response = JSON.parse(this.responseText);
-                if (response) {
-                    if (_.has(response, 'data')) {
-                        onData(response.data);
-                        return;
+        /* Request an endpoint, passing its data to onData.  If maxAge (in
+           milliseconds) is given and the cached response is younger than
+           that, the cached data is used without any request at all.  Errors
+           are passed to onError with a flag that is true for failures that
+           may succeed if retried: network errors and server errors. */
+        request: function (endpoint, onData, onError, maxAge) {
+            var self = this,
+                cached = self.loadCache(endpoint),
+                headers = {};
+
+            if (cached && maxAge && (Date.now() - cached.fetched) < maxAge) {
+                console.log('CACHED ' + API_ROOT + endpoint);
+                onData(cached.data);
+                return;
+            }
+
+            if (cached && cached.etag) {
+                headers['If-None-Match'] = cached.etag;
+            }
+            if (cached && cached.lastModified) {
+                headers['If-Modified-Since'] = cached.lastModified;
+            }
+
+            self.get(API_ROOT + endpoint, headers, function (xhr) {
+                if (xhr.status === 304 && cached) {
+                    cached.fetched = Date.now();
+                    self.saveCache(endpoint, cached);
+                    onData(cached.data);
+                    return;
+                }
+
+                var response = parseResponse(xhr);
+                if (response && _.has(response, 'data')) {
+                    self.saveCache(endpoint, {
+                        etag: xhr.getResponseHeader('ETag'),
+                        lastModified: xhr.getResponseHeader('Last-Modified'),
+                        fetched: Date.now(),
+                        data: response.data
+                    });
+                    onData(response.data);
+                    return;
+                }
+
+                onError(errorText(xhr, response), isTransient(xhr));
+            }, onError);
+        },
+
+        /* Bring a locally stored copy of a collection up to date, fetching
+           only the resources updated since the last sync, and following the
+           pages of the response.  reduce(resource) returns the record to keep
+           for a resource, or null to drop it.  The store is saved only once
+           every page has been received, so an interrupted sync is done again
+           from the same point.  onData is passed the records, by id. */
+        sync: function (endpoint, reduce, onData, onError) {
+            var self = this,
+                key = 'sync:' + endpoint,
+                store = self.loadCache(key) || { updatedAfter: null, records: {} },
+                updatedAfter = store.updatedAfter,
+                url = API_ROOT + endpoint;
+
+            if (store.updatedAfter) {
+                url += (endpoint.indexOf('?') < 0 ? '?' : '&') +
+                    'updated_after=' + encodeURIComponent(store.updatedAfter);
+            }
+
+            var receivePage = function (xhr) {
+                var response = parseResponse(xhr);
+                if (!response || !_.has(response, 'data')) {
+                    onError(errorText(xhr, response), isTransient(xhr));
+                    return;
+                }
+
+                _.each(response.data, function (resource) {
+                    var record = reduce(resource);
+                    if (record) {
+                        store.records[resource.id] = record;
+                    } else {
+                        delete store.records[resource.id];
                     }
-                    if (_.has(response, 'error')) {
-                        onError(response.error.message);
-                        return;
+                    if (!updatedAfter || resource.data_updated_at > updatedAfter) {
+                        updatedAfter = resource.data_updated_at;
                     }
+                });
+
+                if (response.pages && response.pages.next_url) {
+                    self.get(response.pages.next_url, {}, receivePage, onError);
+                    return;
                 }
-                
-                onError(this.status + ' ' + this.statusText.toString());
+
+                console.log('Synced ' + _.size(store.records) + ' ' + endpoint);
+                store.updatedAfter = updatedAfter;
+                self.saveCache(key, store);
+                onData(store.records);
             };
 
-            console.log('GET ' + url);
-            xhr.open('GET', url);
-            xhr.setRequestHeader('Wanikani-Revision', '20170710');
-            xhr.setRequestHeader('Authorization', 'Bearer ' + this.token);
-            xhr.send();
+            self.get(url, {}, receivePage, onError);
+        },
+
+        /* Send a GET request when the rate limit allows, and pass the
+           finished request to onLoad, whatever its status, once any retries
+           for rate limiting are used up. */
+        get: function (url, headers, onLoad, onError) {
+            var self = this,
+                attempts = 0;
+
+            var send = function () {
+                var xhr = new XMLHttpRequest();
+                xhr.onload = function () {
+                    if (this.status === 429 && attempts < RATE_LIMIT_RETRIES) {
+                        var reset = parseInt(this.getResponseHeader('RateLimit-Reset'), 10);
+                        attempts += 1;
+                        self.bucket.pause(isNaN(reset) ? Date.now() + RATE_LIMIT_PERIOD : reset * 1000);
+                        console.log('RATE LIMITED ' + url);
+                        self.bucket.schedule(send);
+                        return;
+                    }
+                    onLoad(this);
+                };
+                xhr.onerror = function () {
+                    onError('Could not reach WaniKani.', true);
+                };
+
+                console.log('GET ' + url);
+                xhr.open('GET', url);
+                xhr.setRequestHeader('Wanikani-Revision', '20170710');
+                xhr.setRequestHeader('Authorization', 'Bearer ' + self.token);
+                _.each(headers, function (value, name) {
+                    xhr.setRequestHeader(name, value);
+                });
+                xhr.send();
+            };
+
+            self.bucket.schedule(send);
+        },
+
+        loadCache: function (endpoint) {
+            var key = this.cachePrefix + endpoint,
+                encoded = window.localStorage.getItem(key);
+            if (encoded) {
+                try {
+                    return JSON.parse(encoded);
+                } catch (ex) {
+                    window.localStorage.removeItem(key);
+                }
+            }
+            return null;
+        },
+
+        saveCache: function (endpoint, entry) {
+            window.localStorage.setItem(this.cachePrefix + endpoint, JSON.stringify(entry));
         }
 
     };
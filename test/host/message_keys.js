@@ -0,0 +1,17 @@
+/* Write the message_keys.auto.h that the Pebble SDK would generate from the
+   messageKeys in package.json, numbering them from 10000 as the SDK does. */
+
+var fs = require('fs');
+var path = require('path');
+
+var pkg = JSON.parse(fs.readFileSync(path.join(__dirname, '../../package.json'), 'utf8'));
+var lines = ['#pragma once', ''];
+var next = 10000;
+
+pkg.pebble.messageKeys.forEach(function (entry) {
+    var match = /^(\w+)(?:\[(\d+)\])?$/.exec(entry);
+    lines.push('#define MESSAGE_KEY_' + match[1] + ' ' + next);
+    next += match[2] ? parseInt(match[2], 10) : 1;
+});
+
+fs.writeFileSync(process.argv[2], lines.join('\n') + '\n');
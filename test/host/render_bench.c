@@ -0,0 +1,161 @@
+/* Render benchmark for the main screen.
+
+   Runs the app on the host, delivers it synthetic summaries with forecasts
+   of 0 to 120 entries over AppMessage, as the phone would, and draws the
+   main screen in its rows and histogram views.  For each, it reports the
+   drawing and formatting calls made by the first frame after the summary
+   arrives (cold) and by a redraw with nothing changed (warm), the mean host
+   time of a warm frame, and the calls made while taking in the summary.
+   The host times are only good for comparing one build with another.
+
+   If given a directory, the cold frames are saved there as PPM images. */
+
+#define main tabitabi_main
+#include "main.c"
+#undef main
+
+#include <time.h>
+
+#if defined(PBL_PLATFORM_APLITE)
+static const char* kPlatform = "aplite";
+#elif defined(PBL_PLATFORM_BASALT)
+static const char* kPlatform = "basalt";
+#elif defined(PBL_PLATFORM_CHALK)
+static const char* kPlatform = "chalk";
+#else
+static const char* kPlatform = "diorite";
+#endif
+
+static const time_t kStartTime = 1772443800; // 2026-03-02 09:30 UTC, a Monday.
+static const int kEntryCounts[] = { 0, 1, 6, 24, 48, 96, 120 };
+enum { kWarmFrames = 200 };
+
+static const char* s_frames_dir;
+
+static uint8_t* put_varint(uint8_t* p, uint32_t value) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+/* Send a summary with the given number of forecast entries, one an hour
+   from the next hour on, split over REVIEW_FORECAST chunks as the phone
+   splits them, and then SUCCESS. */
+static void deliver_summary(int entries) {
+    int32_t epoch_hour = shim_time(NULL) / kOneHour;
+    uint8_t chunk[kForecastChunkSize];
+    int k = 0;
+    bool first = true;
+    do {
+        uint8_t* p = chunk;
+        *p++ = kForecastFormatVersion;
+        *p++ = first ? 0 : kForecastAppend;
+        p = put_varint(p, epoch_hour + k);
+        while (k < entries && (chunk + sizeof chunk) - p >= 2 * 5) {
+            p = put_varint(p, 1);
+            p = put_varint(p, 1 + (k * 37 + entries) % 23 + (k % 11 == 0 ? 150 : 0));
+            k += 1;
+        }
+        shim_dict_begin();
+        if (first) {
+            shim_dict_add_int(MESSAGE_KEY_EPOCH_HOUR, epoch_hour);
+            shim_dict_add_int(MESSAGE_KEY_LESSON_COUNT, 15);
+            shim_dict_add_int(MESSAGE_KEY_REVIEW_COUNT, 42);
+            shim_dict_add_int(MESSAGE_KEY_FETCHED_AT, shim_time(NULL));
+            shim_dict_add_int(MESSAGE_KEY_FRESHNESS_TTL, 30);
+        }
+        shim_dict_add_data(MESSAGE_KEY_REVIEW_FORECAST, chunk, p - chunk);
+        shim_deliver();
+        first = false;
+    } while (k < entries);
+
+    shim_dict_begin();
+    shim_dict_add_int(MESSAGE_KEY_SUCCESS, 1);
+    shim_deliver();
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void print_counts(const char* view, int entries, const char* frame, const ShimCounts* counts, double us) {
+    printf("%-8s %7d  %-9s  %-6s %5lu %5lu %5lu %6lu %7lu %8lu %9lu",
+        kPlatform, entries, view, frame,
+        (unsigned long)counts->draw_text, (unsigned long)counts->fill_rect,
+        (unsigned long)counts->draw_line, (unsigned long)counts->draw_bitmap,
+        (unsigned long)counts->capture_frame_buffer,
+        (unsigned long)counts->snprintf_calls, (unsigned long)counts->localtime_calls);
+    if (us >= 0) {
+        printf(" %10.1f", us);
+    }
+    printf("\n");
+}
+
+static void measure_view(const char* view, int entries) {
+    shim_reset_counts();
+    shim_render();
+    print_counts(view, entries, "cold", &g_shim_counts, -1);
+
+    if (s_frames_dir) {
+        char path[256];
+        snprintf(path, sizeof path, "%s/%s-%03d.ppm", s_frames_dir, view, entries);
+        if (!shim_save_ppm(path)) {
+            fprintf(stderr, "Could not write %s\n", path);
+        }
+    }
+
+    ShimCounts warm;
+    shim_reset_counts();
+    shim_render();
+    warm = g_shim_counts;
+    double start = now_us();
+    for (int k = 0; k < kWarmFrames; ++k) {
+        shim_render();
+    }
+    print_counts(view, entries, "warm", &warm, (now_us() - start) / kWarmFrames);
+}
+
+static void run_benchmark(void) {
+    /* Let the phone answer, so that the app does not time out waiting. */
+    shim_dict_begin();
+    shim_dict_add_int(MESSAGE_KEY_AppReadyService_Ready, 1);
+    shim_deliver();
+
+    printf("platform entries  view       frame   text rects lines bitmap capture snprintf localtime   us/frame\n");
+    for (size_t n = 0; n < ARRAY_LENGTH(kEntryCounts); ++n) {
+        int entries = kEntryCounts[n];
+
+        shim_reset_counts();
+        deliver_summary(entries);
+        print_counts("summary", entries, "update", &g_shim_counts, -1);
+
+        /* Let the window transitions finish. */
+        shim_advance_ms(1000);
+        measure_view("rows", entries);
+
+        shim_click(BUTTON_ID_SELECT, false);
+        shim_advance_ms(1000);
+        measure_view("histogram", entries);
+
+        /* Back to the rows; the stages view is skipped without progress. */
+        shim_click(BUTTON_ID_SELECT, false);
+    }
+}
+
+int main(int argc, char** argv) {
+    setenv("TZ", "UTC", 1);
+    tzset();
+    s_frames_dir = argc > 1 ? argv[1] : NULL;
+
+    shim_set_time(kStartTime);
+    shim_set_clock_24h(true);
+    shim_set_launch(APP_LAUNCH_USER, 0);
+    g_shim_event_loop = run_benchmark;
+    tabitabi_main();
+    return 0;
+}
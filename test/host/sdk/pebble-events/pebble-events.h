@@ -0,0 +1,19 @@
+#pragma once
+
+/* A stand-in for the pebble-events package, which lets several handlers
+   share the AppMessage inbox and outbox. */
+
+#include <pebble.h>
+
+typedef void* EventHandle;
+typedef void (*AppMessageInboxReceived)(DictionaryIterator* iterator, void* context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator* iterator, void* context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator* iterator, AppMessageResult reason, void* context);
+
+void events_app_message_request_inbox_size(uint32_t size);
+void events_app_message_request_outbox_size(uint32_t size);
+EventHandle events_app_message_register_inbox_received(AppMessageInboxReceived received_callback, void* context);
+EventHandle events_app_message_register_outbox_sent(AppMessageOutboxSent sent_callback, void* context);
+EventHandle events_app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback, void* context);
+void events_app_message_unsubscribe(EventHandle handle);
+AppMessageResult events_app_message_open(void);
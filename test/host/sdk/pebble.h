@@ -0,0 +1,518 @@
+#pragma once
+
+/* A stand-in for the Pebble SDK, for building src/c/main.c on the host.
+
+   It declares the subset of the SDK that the app uses, with the same names
+   and types, and is implemented by pebble_shim.c: layers and windows are
+   real, drawing is rasterized into an 8 bit canvas the size of the selected
+   platform's display, and persistent storage, timers, time and AppMessage
+   are simulated.  The platform is chosen with one of PBL_PLATFORM_APLITE,
+   PBL_PLATFORM_BASALT, PBL_PLATFORM_CHALK or PBL_PLATFORM_DIORITE.
+
+   The declarations after "Host shim controls" are not part of the SDK; they
+   let a test drive the app and inspect what it drew. */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// --------------------------------------------------------------------------
+// Platform
+// --------------------------------------------------------------------------
+
+#if defined(PBL_PLATFORM_APLITE)
+#define PBL_BW
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_BASALT)
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_CHALK)
+#define PBL_COLOR
+#define PBL_ROUND
+#define PBL_DISPLAY_WIDTH 180
+#define PBL_DISPLAY_HEIGHT 180
+#elif defined(PBL_PLATFORM_DIORITE)
+#define PBL_BW
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#else
+#error "Define one of PBL_PLATFORM_APLITE, _BASALT, _CHALK or _DIORITE."
+#endif
+
+#if defined(PBL_COLOR)
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_true)
+#else
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_false)
+#endif
+
+#if defined(PBL_ROUND)
+#define PBL_IF_RECT_ELSE(if_true, if_false) (if_false)
+#define PBL_IF_ROUND_ELSE(if_true, if_false) (if_true)
+#else
+#define PBL_IF_RECT_ELSE(if_true, if_false) (if_true)
+#define PBL_IF_ROUND_ELSE(if_true, if_false) (if_false)
+#endif
+
+/* Aplite is the only platform without app glances. */
+#if defined(PBL_PLATFORM_APLITE)
+#define PBL_API_EXISTS(api) 0
+#else
+#define PBL_API_EXISTS(api) 1
+#endif
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+#define SECONDS_PER_MINUTE 60
+#define SECONDS_PER_HOUR 3600
+#define SECONDS_PER_DAY 86400
+
+// --------------------------------------------------------------------------
+// Logging
+// --------------------------------------------------------------------------
+
+typedef enum {
+    APP_LOG_LEVEL_ERROR = 1,
+    APP_LOG_LEVEL_WARNING = 50,
+    APP_LOG_LEVEL_INFO = 100,
+    APP_LOG_LEVEL_DEBUG = 200,
+    APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char* src_filename, int src_line_number, const char* fmt, ...);
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+
+// --------------------------------------------------------------------------
+// Graphics types
+// --------------------------------------------------------------------------
+
+typedef union GColor8 {
+    uint8_t argb;
+    struct {
+        uint8_t b:2;
+        uint8_t g:2;
+        uint8_t r:2;
+        uint8_t a:2;
+    };
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorClearARGB8          0x00
+#define GColorBlackARGB8          0xC0
+#define GColorBlueARGB8           0xC3
+#define GColorVividCeruleanARGB8  0xDB
+#define GColorDarkGrayARGB8       0xD5
+#define GColorLightGrayARGB8      0xEA
+#define GColorFollyARGB8          0xF1
+#define GColorFashionMagentaARGB8 0xF3
+#define GColorWhiteARGB8          0xFF
+
+#define GColorClear ((GColor8){.argb = GColorClearARGB8})
+#define GColorBlack ((GColor8){.argb = GColorBlackARGB8})
+#define GColorWhite ((GColor8){.argb = GColorWhiteARGB8})
+#define GColorFolly ((GColor8){.argb = GColorFollyARGB8})
+
+typedef struct GPoint {
+    int16_t x;
+    int16_t y;
+} GPoint;
+#define GPoint(x, y) ((GPoint){(x), (y)})
+
+typedef struct GSize {
+    int16_t w;
+    int16_t h;
+} GSize;
+#define GSize(w, h) ((GSize){(w), (h)})
+
+typedef struct GRect {
+    GPoint origin;
+    GSize size;
+} GRect;
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+typedef struct GEdgeInsets {
+    int16_t top;
+    int16_t right;
+    int16_t bottom;
+    int16_t left;
+} GEdgeInsets;
+
+typedef enum {
+    GCornerNone        = 0,
+    GCornerTopLeft     = 1 << 0,
+    GCornerTopRight    = 1 << 1,
+    GCornerBottomLeft  = 1 << 2,
+    GCornerBottomRight = 1 << 3,
+    GCornersAll        = 0x0F,
+    GCornersTop        = GCornerTopLeft | GCornerTopRight,
+    GCornersBottom     = GCornerBottomLeft | GCornerBottomRight,
+    GCornersLeft       = GCornerTopLeft | GCornerBottomLeft,
+    GCornersRight      = GCornerTopRight | GCornerBottomRight,
+} GCornerMask;
+
+typedef enum {
+    GTextAlignmentLeft,
+    GTextAlignmentCenter,
+    GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+    GTextOverflowModeWordWrap,
+    GTextOverflowModeTrailingEllipsis,
+    GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+    GBitmapFormat1Bit,
+    GBitmapFormat8Bit,
+    GBitmapFormat1BitPalette,
+    GBitmapFormat2BitPalette,
+    GBitmapFormat4BitPalette,
+    GBitmapFormat8BitCircular,
+} GBitmapFormat;
+
+typedef struct GBitmapDataRowInfo {
+    uint8_t* data; // data[min_x] is the first pixel of the row.
+    int16_t min_x;
+    int16_t max_x;
+} GBitmapDataRowInfo;
+
+typedef struct GContext GContext;
+typedef struct GBitmap GBitmap;
+typedef struct GFontInfo* GFont;
+typedef struct GTextAttributes GTextAttributes;
+typedef struct Layer Layer;
+typedef struct Window Window;
+typedef struct AppTimer AppTimer;
+
+GRect grect_inset(GRect rect, GEdgeInsets insets);
+bool grect_equal(const GRect* const rect_a, const GRect* const rect_b);
+bool gpoint_equal(const GPoint* const point_a, const GPoint* const point_b);
+
+// --------------------------------------------------------------------------
+// Fonts and text
+// --------------------------------------------------------------------------
+
+#define FONT_KEY_GOTHIC_14      "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18      "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24      "RESOURCE_ID_GOTHIC_24"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_GOTHIC_28      "RESOURCE_ID_GOTHIC_28"
+#define FONT_KEY_GOTHIC_28_BOLD "RESOURCE_ID_GOTHIC_28_BOLD"
+
+GFont fonts_get_system_font(const char* font_key);
+GTextAttributes* graphics_text_attributes_create(void);
+void graphics_text_attributes_destroy(GTextAttributes* text_attributes);
+void graphics_text_attributes_enable_screen_text_flow(GTextAttributes* text_attributes, uint8_t inset);
+GSize graphics_text_layout_get_content_size(const char* text, const GFont font, const GRect box,
+    const GTextOverflowMode overflow_mode, const GTextAlignment alignment);
+void graphics_draw_text(GContext* ctx, const char* text, GFont const font, const GRect box,
+    const GTextOverflowMode overflow_mode, const GTextAlignment alignment, GTextAttributes* text_attributes);
+
+// --------------------------------------------------------------------------
+// Drawing
+// --------------------------------------------------------------------------
+
+void graphics_context_set_fill_color(GContext* ctx, GColor color);
+void graphics_context_set_stroke_color(GContext* ctx, GColor color);
+void graphics_context_set_text_color(GContext* ctx, GColor color);
+void graphics_fill_rect(GContext* ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_rect(GContext* ctx, GRect rect);
+void graphics_draw_line(GContext* ctx, GPoint p0, GPoint p1);
+void graphics_draw_bitmap_in_rect(GContext* ctx, const GBitmap* bitmap, GRect rect);
+GBitmap* graphics_capture_frame_buffer(GContext* ctx);
+bool graphics_release_frame_buffer(GContext* ctx, GBitmap* buffer);
+
+GBitmap* gbitmap_create_blank(GSize size, GBitmapFormat format);
+void gbitmap_destroy(GBitmap* bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap* bitmap);
+GRect gbitmap_get_bounds(const GBitmap* bitmap);
+void gbitmap_set_bounds(GBitmap* bitmap, GRect bounds);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap* bitmap);
+uint8_t* gbitmap_get_data(const GBitmap* bitmap);
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap* bitmap, uint16_t y);
+
+// --------------------------------------------------------------------------
+// Layers and windows
+// --------------------------------------------------------------------------
+
+typedef void (*LayerUpdateProc)(Layer* layer, GContext* ctx);
+
+Layer* layer_create(GRect frame);
+Layer* layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer* layer);
+void* layer_get_data(const Layer* layer);
+void layer_set_update_proc(Layer* layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer* layer);
+GRect layer_get_frame(const Layer* layer);
+void layer_set_frame(Layer* layer, GRect frame);
+GRect layer_get_bounds(const Layer* layer);
+void layer_set_bounds(Layer* layer, GRect bounds);
+void layer_add_child(Layer* parent, Layer* child);
+void layer_remove_from_parent(Layer* child);
+bool layer_get_hidden(const Layer* layer);
+void layer_set_hidden(Layer* layer, bool hidden);
+Window* layer_get_window(const Layer* layer);
+GRect layer_convert_rect_to_screen(const Layer* layer, GRect rect);
+
+typedef void (*WindowHandler)(Window* window);
+typedef struct WindowHandlers {
+    WindowHandler load;
+    WindowHandler appear;
+    WindowHandler disappear;
+    WindowHandler unload;
+} WindowHandlers;
+
+typedef enum {
+    BUTTON_ID_BACK,
+    BUTTON_ID_UP,
+    BUTTON_ID_SELECT,
+    BUTTON_ID_DOWN,
+    NUM_BUTTONS,
+} ButtonId;
+
+typedef void* ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void* context);
+typedef void (*ClickConfigProvider)(void* context);
+
+Window* window_create(void);
+void window_destroy(Window* window);
+void window_set_window_handlers(Window* window, WindowHandlers handlers);
+void window_set_background_color(Window* window, GColor background_color);
+void window_set_click_config_provider(Window* window, ClickConfigProvider click_config_provider);
+Layer* window_get_root_layer(const Window* window);
+bool window_is_loaded(Window* window);
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler);
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler);
+
+void window_stack_push(Window* window, bool animated);
+bool window_stack_remove(Window* window, bool animated);
+void window_stack_pop_all(const bool animated);
+bool window_stack_contains_window(Window* window);
+Window* window_stack_get_top_window(void);
+
+// --------------------------------------------------------------------------
+// Time, timers and the event loop
+// --------------------------------------------------------------------------
+
+typedef void (*AppTimerCallback)(void* data);
+
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* callback_data);
+bool app_timer_reschedule(AppTimer* timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer* timer_handle);
+
+uint16_t time_ms(time_t* tloc, uint16_t* out_ms);
+time_t time_start_of_today(void);
+bool clock_is_24h_style(void);
+
+void app_event_loop(void);
+
+typedef enum {
+    APP_LAUNCH_SYSTEM,
+    APP_LAUNCH_USER,
+    APP_LAUNCH_PHONE,
+    APP_LAUNCH_WAKEUP,
+    APP_LAUNCH_WORKER,
+    APP_LAUNCH_QUICK_LAUNCH,
+    APP_LAUNCH_TIMELINE_ACTION,
+    APP_LAUNCH_SMARTSTRAP,
+} AppLaunchReason;
+
+AppLaunchReason launch_reason(void);
+uint32_t launch_get_args(void);
+
+typedef enum {
+    APP_EXIT_NOT_SPECIFIED = 0,
+    APP_EXIT_ACTION_PERFORMED_SUCCESSFULLY,
+} AppExitReason;
+
+void exit_reason_set(AppExitReason reason);
+
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+
+// --------------------------------------------------------------------------
+// Persistent storage
+// --------------------------------------------------------------------------
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define E_DOES_NOT_EXIST (-10)
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void* data, const size_t size);
+int persist_delete(const uint32_t key);
+
+// --------------------------------------------------------------------------
+// Dictionaries and AppMessage
+// --------------------------------------------------------------------------
+
+typedef enum {
+    TUPLE_BYTE_ARRAY = 0,
+    TUPLE_CSTRING = 1,
+    TUPLE_UINT = 2,
+    TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) Tuple {
+    uint32_t key;
+    TupleType type:8;
+    uint16_t length;
+    union {
+        uint8_t data[0];
+        char cstring[0];
+        uint8_t uint8;
+        uint16_t uint16;
+        uint32_t uint32;
+        int8_t int8;
+        int16_t int16;
+        int32_t int32;
+    } value[];
+} Tuple;
+
+typedef struct DictionaryIterator {
+    uint8_t* begin;
+    uint8_t* end;
+    uint8_t* cursor;
+} DictionaryIterator;
+
+typedef enum {
+    DICT_OK = 0,
+    DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+} DictionaryResult;
+
+typedef enum {
+    APP_MSG_OK = 0,
+    APP_MSG_SEND_REJECTED = 1 << 2,
+    APP_MSG_BUSY = 1 << 10,
+} AppMessageResult;
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key);
+Tuple* dict_read_first(DictionaryIterator* iter);
+Tuple* dict_read_next(DictionaryIterator* iter);
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring);
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value);
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator** iterator);
+AppMessageResult app_message_outbox_send(void);
+
+// --------------------------------------------------------------------------
+// App glances
+// --------------------------------------------------------------------------
+
+typedef struct AppGlanceReloadSession AppGlanceReloadSession;
+
+typedef struct AppGlanceSlice {
+    struct {
+        uint32_t icon;
+        const char* subtitle_template_string;
+    } layout;
+    time_t expiration_time;
+} AppGlanceSlice;
+
+typedef enum {
+    APP_GLANCE_RESULT_SUCCESS = 0,
+} AppGlanceResult;
+
+#define APP_GLANCE_SLICE_NO_EXPIRATION ((time_t)0)
+
+typedef void (*AppGlanceReloadCallback)(AppGlanceReloadSession* session, size_t limit, void* context);
+
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession* session, AppGlanceSlice slice);
+void app_glance_reload(AppGlanceReloadCallback callback, void* context);
+
+#define PUBLISHED_ID_ICON 1
+
+#include "message_keys.auto.h"
+
+// --------------------------------------------------------------------------
+// Host shim controls
+// --------------------------------------------------------------------------
+
+/* Calls counted since the last shim_reset_counts(). */
+typedef struct ShimCounts {
+    uint32_t draw_text;
+    uint32_t fill_rect;
+    uint32_t draw_line;
+    uint32_t draw_bitmap;
+    uint32_t capture_frame_buffer;
+    uint32_t snprintf_calls;
+    uint32_t localtime_calls;
+    uint32_t update_procs;
+} ShimCounts;
+
+extern ShimCounts g_shim_counts;
+
+void shim_reset_counts(void);
+
+/* The simulated wall clock, in seconds and milliseconds since the epoch.
+   Advancing it fires the timers that come due. */
+void shim_set_time(time_t seconds);
+void shim_advance_ms(uint32_t ms);
+void shim_set_clock_24h(bool clock_24h);
+void shim_set_launch(AppLaunchReason reason, uint32_t args);
+
+/* Draw the top window into the canvas.  During a window transition, which
+   lasts 300 ms after an animated push or remove, the window is drawn offset
+   as it slides in; shim_render_offset() draws it at a given offset. */
+void shim_render(void);
+void shim_render_offset(GPoint offset);
+
+/* The canvas holds one 8 bit color per display pixel.  Pixels outside the
+   round display are never drawn. */
+GColor shim_canvas_pixel(int16_t x, int16_t y);
+void shim_canvas_clear(GColor color);
+bool shim_save_ppm(const char* path);
+
+/* The display's frame buffer spans: every pixel on rectangular displays,
+   and the visible span of each row on the round one. */
+void shim_display_row_span(int16_t y, int16_t* min_x, int16_t* max_x);
+
+/* Press a button on the top window. */
+void shim_click(ButtonId button, bool long_press);
+
+/* Deliver a message to the app's inbox handlers, built with the shim_dict
+   functions, and read back the last message that the app sent.  A sent
+   message keeps the outbox busy until shim_outbox_complete() acknowledges
+   it, or rejects it, and calls the app's outbox handlers. */
+DictionaryIterator* shim_dict_begin(void);
+void shim_dict_add_int(uint32_t key, int32_t value);
+void shim_dict_add_data(uint32_t key, const uint8_t* data, uint16_t length);
+void shim_dict_add_cstring(uint32_t key, const char* text);
+void shim_deliver(void);
+DictionaryIterator* shim_last_outbox(void);
+void shim_outbox_complete(bool delivered);
+
+void shim_persist_clear(void);
+
+/* Called by app_event_loop(), so that a test can drive the app between the
+   setup and the teardown in its main(). */
+extern void (*g_shim_event_loop)(void);
+
+/* Count the library calls that the render benchmark reports.  The shim
+   itself is built without these. */
+#if !defined(SHIM_IMPLEMENTATION)
+int shim_snprintf(char* buffer, size_t size, const char* format, ...);
+struct tm* shim_localtime(const time_t* timep);
+time_t shim_time(time_t* tloc);
+#define snprintf shim_snprintf
+#define localtime shim_localtime
+#define time(tloc) shim_time(tloc)
+#endif
@@ -0,0 +1,1302 @@
+/* The host implementation of the Pebble SDK stand-in declared in pebble.h.
+
+   Nothing here tries to be pixel exact.  Rectangles, lines and bitmaps are
+   rasterized as the watch would, clipped to the layer and, on chalk, to the
+   round display.  Text is drawn as one solid block per character, in a cell
+   sized from the font's point size, which is enough to check where text
+   lands and how much of it there is. */
+
+#define SHIM_IMPLEMENTATION
+#include <pebble.h>
+#include <pebble-events/pebble-events.h>
+#include <math.h>
+
+ShimCounts g_shim_counts;
+
+void shim_reset_counts(void) {
+    memset(&g_shim_counts, 0, sizeof g_shim_counts);
+}
+
+// --------------------------------------------------------------------------
+// Logging
+// --------------------------------------------------------------------------
+
+void app_log(uint8_t log_level, const char* src_filename, int src_line_number, const char* fmt, ...) {
+    if (!getenv("SHIM_LOG")) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "[%u] %s:%d ", log_level, src_filename, src_line_number);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// --------------------------------------------------------------------------
+// Counted library calls
+// --------------------------------------------------------------------------
+
+static int64_t s_now_ms;
+
+int shim_snprintf(char* buffer, size_t size, const char* format, ...) {
+    g_shim_counts.snprintf_calls += 1;
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return result;
+}
+
+struct tm* shim_localtime(const time_t* timep) {
+    static struct tm result;
+    g_shim_counts.localtime_calls += 1;
+    return localtime_r(timep, &result);
+}
+
+time_t shim_time(time_t* tloc) {
+    time_t now = (time_t)(s_now_ms / 1000);
+    if (tloc) {
+        *tloc = now;
+    }
+    return now;
+}
+
+// --------------------------------------------------------------------------
+// Geometry
+// --------------------------------------------------------------------------
+
+GRect grect_inset(GRect rect, GEdgeInsets insets) {
+    GRect result = {
+        { rect.origin.x + insets.left, rect.origin.y + insets.top },
+        { rect.size.w - insets.left - insets.right, rect.size.h - insets.top - insets.bottom },
+    };
+    if (result.size.w < 0 || result.size.h < 0) {
+        return GRect(0, 0, 0, 0);
+    }
+    return result;
+}
+
+bool grect_equal(const GRect* const rect_a, const GRect* const rect_b) {
+    return rect_a->origin.x == rect_b->origin.x && rect_a->origin.y == rect_b->origin.y
+        && rect_a->size.w == rect_b->size.w && rect_a->size.h == rect_b->size.h;
+}
+
+bool gpoint_equal(const GPoint* const point_a, const GPoint* const point_b) {
+    return point_a->x == point_b->x && point_a->y == point_b->y;
+}
+
+static GRect grect_intersect(GRect a, GRect b) {
+    int16_t x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+    int16_t y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+    int16_t x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+    int16_t y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+    if (x1 <= x0 || y1 <= y0) {
+        return GRect(x0, y0, 0, 0);
+    }
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// --------------------------------------------------------------------------
+// The display
+// --------------------------------------------------------------------------
+
+enum { kWidth = PBL_DISPLAY_WIDTH, kHeight = PBL_DISPLAY_HEIGHT };
+
+static uint8_t s_canvas[kHeight][kWidth];
+
+void shim_display_row_span(int16_t y, int16_t* min_x, int16_t* max_x) {
+#if defined(PBL_ROUND)
+    /* The pixels whose centers lie within the display circle. */
+    double r = kWidth / 2.0;
+    double dy = y + 0.5 - r;
+    double half = sqrt(r * r - dy * dy);
+    *min_x = (int16_t)ceil(r - half - 0.5);
+    *max_x = (int16_t)floor(r + half - 0.5);
+#else
+    (void)y;
+    *min_x = 0;
+    *max_x = kWidth - 1;
+#endif
+}
+
+static bool on_display(int16_t x, int16_t y) {
+    if (x < 0 || y < 0 || x >= kWidth || y >= kHeight) {
+        return false;
+    }
+#if defined(PBL_ROUND)
+    int16_t min_x, max_x;
+    shim_display_row_span(y, &min_x, &max_x);
+    return x >= min_x && x <= max_x;
+#else
+    return true;
+#endif
+}
+
+/* The black and white displays have only the two colors. */
+static uint8_t display_color(GColor color) {
+#if defined(PBL_BW)
+    return (color.r + color.g + color.b) >= 5 ? GColorWhiteARGB8 : GColorBlackARGB8;
+#else
+    return color.argb | 0xC0;
+#endif
+}
+
+GColor shim_canvas_pixel(int16_t x, int16_t y) {
+    GColor color = { .argb = GColorClearARGB8 };
+    if (on_display(x, y)) {
+        color.argb = s_canvas[y][x];
+    }
+    return color;
+}
+
+void shim_canvas_clear(GColor color) {
+    for (int16_t y = 0; y < kHeight; ++y) {
+        for (int16_t x = 0; x < kWidth; ++x) {
+            s_canvas[y][x] = on_display(x, y) ? display_color(color) : GColorBlackARGB8;
+        }
+    }
+}
+
+bool shim_save_ppm(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", kWidth, kHeight);
+    for (int16_t y = 0; y < kHeight; ++y) {
+        for (int16_t x = 0; x < kWidth; ++x) {
+            GColor color = { .argb = s_canvas[y][x] };
+            uint8_t rgb[3] = { color.r * 85, color.g * 85, color.b * 85 };
+            fwrite(rgb, 1, sizeof rgb, file);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+// --------------------------------------------------------------------------
+// Fonts and text
+// --------------------------------------------------------------------------
+
+struct GFontInfo {
+    const char* key;
+    int16_t line_height;
+    int16_t top; // from the top of the line to the top of the capitals.
+    int16_t cap_height;
+    int16_t advance;
+};
+
+static struct GFontInfo s_fonts[] = {
+    { FONT_KEY_GOTHIC_14,      14,  5,  9,  5 },
+    { FONT_KEY_GOTHIC_14_BOLD, 14,  5,  9,  5 },
+    { FONT_KEY_GOTHIC_18,      18,  7, 11,  7 },
+    { FONT_KEY_GOTHIC_18_BOLD, 18,  7, 11,  8 },
+    { FONT_KEY_GOTHIC_24,      24,  9, 15, 10 },
+    { FONT_KEY_GOTHIC_24_BOLD, 24,  9, 15, 10 },
+    { FONT_KEY_GOTHIC_28,      28, 10, 18, 12 },
+    { FONT_KEY_GOTHIC_28_BOLD, 28, 10, 18, 13 },
+};
+
+GFont fonts_get_system_font(const char* font_key) {
+    for (size_t k = 0; k < ARRAY_LENGTH(s_fonts); ++k) {
+        if (strcmp(s_fonts[k].key, font_key) == 0) {
+            return &s_fonts[k];
+        }
+    }
+    return &s_fonts[0];
+}
+
+struct GTextAttributes {
+    uint8_t flow_inset;
+};
+
+GTextAttributes* graphics_text_attributes_create(void) {
+    return calloc(1, sizeof(GTextAttributes));
+}
+
+void graphics_text_attributes_destroy(GTextAttributes* text_attributes) {
+    free(text_attributes);
+}
+
+void graphics_text_attributes_enable_screen_text_flow(GTextAttributes* text_attributes, uint8_t inset) {
+    text_attributes->flow_inset = inset;
+}
+
+typedef struct TextLine {
+    const char* text;
+    int16_t length;
+} TextLine;
+
+enum { kMaxTextLines = 16 };
+
+/* Break the text into lines at spaces and newlines, so that each line fits
+   the width, and return the number of lines. */
+static int wrap_text(const char* text, GFont font, int16_t width, TextLine* lines) {
+    int max_chars = width / font->advance;
+    if (max_chars < 1) {
+        max_chars = 1;
+    }
+    int count = 0;
+    const char* p = text;
+    while (*p && count < kMaxTextLines) {
+        const char* start = p;
+        const char* fit = NULL; // the end of the last whole word that fits.
+        while (*p && *p != '\n' && p - start < max_chars) {
+            if (p[1] == ' ' || p[1] == '\n' || p[1] == '\0') {
+                fit = p + 1;
+            }
+            ++p;
+        }
+        if (*p && *p != '\n' && fit) {
+            p = fit;
+        }
+        lines[count].text = start;
+        lines[count].length = p - start;
+        count += 1;
+        while (*p == ' ') {
+            ++p;
+        }
+        if (*p == '\n') {
+            ++p;
+        }
+    }
+    return count;
+}
+
+GSize graphics_text_layout_get_content_size(const char* text, const GFont font, const GRect box,
+    const GTextOverflowMode overflow_mode, const GTextAlignment alignment) {
+    TextLine lines[kMaxTextLines];
+    int count = wrap_text(text, font, box.size.w, lines);
+    int16_t width = 0;
+    for (int k = 0; k < count; ++k) {
+        if (lines[k].length * font->advance > width) {
+            width = lines[k].length * font->advance;
+        }
+    }
+    return GSize(width, count * font->line_height);
+}
+
+// --------------------------------------------------------------------------
+// Bitmaps
+// --------------------------------------------------------------------------
+
+struct GBitmap {
+    GBitmapFormat format;
+    GSize size;
+    GRect bounds;
+    uint16_t stride;
+    uint8_t* data;
+    GBitmapDataRowInfo* rows; // for circular bitmaps.
+};
+
+static uint16_t row_stride(GBitmapFormat format, int16_t width) {
+    /* One bit rows are padded to a whole number of words. */
+    return format == GBitmapFormat1Bit ? ((width + 31) / 32) * 4 : width;
+}
+
+GBitmap* gbitmap_create_blank(GSize size, GBitmapFormat format) {
+    if (format != GBitmapFormat1Bit && format != GBitmapFormat8Bit && format != GBitmapFormat8BitCircular) {
+        return NULL;
+    }
+    GBitmap* bitmap = calloc(1, sizeof(GBitmap));
+    bitmap->format = format;
+    bitmap->size = size;
+    bitmap->bounds = GRect(0, 0, size.w, size.h);
+    if (format == GBitmapFormat8BitCircular) {
+        /* Only the visible span of each row is stored. */
+        bitmap->rows = calloc(size.h, sizeof(GBitmapDataRowInfo));
+        size_t total = 0;
+        for (int16_t y = 0; y < size.h; ++y) {
+            int16_t min_x, max_x;
+            shim_display_row_span(y, &min_x, &max_x);
+            total += max_x - min_x + 1;
+        }
+        bitmap->data = calloc(total, 1);
+        uint8_t* row = bitmap->data;
+        for (int16_t y = 0; y < size.h; ++y) {
+            shim_display_row_span(y, &bitmap->rows[y].min_x, &bitmap->rows[y].max_x);
+            bitmap->rows[y].data = row - bitmap->rows[y].min_x;
+            row += bitmap->rows[y].max_x - bitmap->rows[y].min_x + 1;
+        }
+    } else {
+        bitmap->stride = row_stride(format, size.w);
+        bitmap->data = calloc((size_t)bitmap->stride * size.h, 1);
+    }
+    return bitmap;
+}
+
+void gbitmap_destroy(GBitmap* bitmap) {
+    if (bitmap) {
+        free(bitmap->rows);
+        free(bitmap->data);
+        free(bitmap);
+    }
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap* bitmap) {
+    return bitmap->format;
+}
+
+GRect gbitmap_get_bounds(const GBitmap* bitmap) {
+    return bitmap->bounds;
+}
+
+void gbitmap_set_bounds(GBitmap* bitmap, GRect bounds) {
+    bitmap->bounds = bounds;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap* bitmap) {
+    return bitmap->stride;
+}
+
+uint8_t* gbitmap_get_data(const GBitmap* bitmap) {
+    return bitmap->data;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap* bitmap, uint16_t y) {
+    if (bitmap->rows) {
+        return bitmap->rows[y];
+    }
+    GBitmapDataRowInfo info = {
+        .data = bitmap->data + (size_t)y * bitmap->stride,
+        .min_x = 0,
+        .max_x = bitmap->size.w - 1,
+    };
+    return info;
+}
+
+/* The color of a pixel, or clear if the bitmap does not store it. */
+static uint8_t bitmap_pixel(const GBitmap* bitmap, int16_t x, int16_t y) {
+    if (x < 0 || y < 0 || x >= bitmap->size.w || y >= bitmap->size.h) {
+        return GColorClearARGB8;
+    }
+    GBitmapDataRowInfo row = gbitmap_get_data_row_info(bitmap, y);
+    if (x < row.min_x || x > row.max_x) {
+        return GColorClearARGB8;
+    }
+    if (bitmap->format == GBitmapFormat1Bit) {
+        return (row.data[x / 8] >> (x % 8)) & 1 ? GColorWhiteARGB8 : GColorBlackARGB8;
+    }
+    return row.data[x];
+}
+
+static void set_bitmap_pixel(GBitmap* bitmap, int16_t x, int16_t y, uint8_t argb) {
+    GBitmapDataRowInfo row = gbitmap_get_data_row_info(bitmap, y);
+    if (x < row.min_x || x > row.max_x) {
+        return;
+    }
+    if (bitmap->format == GBitmapFormat1Bit) {
+        uint8_t bit = 1 << (x % 8);
+        if (argb == GColorWhiteARGB8) {
+            row.data[x / 8] |= bit;
+        } else {
+            row.data[x / 8] &= ~bit;
+        }
+    } else {
+        row.data[x] = argb;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Drawing
+// --------------------------------------------------------------------------
+
+struct GContext {
+    GPoint origin; // of the layer being drawn, on the display.
+    GRect clip; // on the display.
+    GColor fill_color;
+    GColor stroke_color;
+    GColor text_color;
+    GBitmap* frame_buffer; // while captured.
+};
+
+static GContext s_context;
+
+static void put_pixel(GContext* ctx, int16_t x, int16_t y, GColor color) {
+    x += ctx->origin.x;
+    y += ctx->origin.y;
+    if (color.a == 0 || !on_display(x, y)
+     || x < ctx->clip.origin.x || x >= ctx->clip.origin.x + ctx->clip.size.w
+     || y < ctx->clip.origin.y || y >= ctx->clip.origin.y + ctx->clip.size.h) {
+        return;
+    }
+    s_canvas[y][x] = display_color(color);
+}
+
+static void fill_box(GContext* ctx, GRect rect, GColor color) {
+    for (int16_t y = rect.origin.y; y < rect.origin.y + rect.size.h; ++y) {
+        for (int16_t x = rect.origin.x; x < rect.origin.x + rect.size.w; ++x) {
+            put_pixel(ctx, x, y, color);
+        }
+    }
+}
+
+void graphics_context_set_fill_color(GContext* ctx, GColor color) {
+    ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext* ctx, GColor color) {
+    ctx->stroke_color = color;
+}
+
+void graphics_context_set_text_color(GContext* ctx, GColor color) {
+    ctx->text_color = color;
+}
+
+/* Whether a pixel of a rectangle lies outside one of its rounded corners. */
+static bool outside_corner(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, GCornerMask mask) {
+    int16_t cx, cy;
+    if (x < r && y < r && (mask & GCornerTopLeft)) {
+        cx = r; cy = r;
+    } else if (x >= w - r && y < r && (mask & GCornerTopRight)) {
+        cx = w - r; cy = r;
+    } else if (x < r && y >= h - r && (mask & GCornerBottomLeft)) {
+        cx = r; cy = h - r;
+    } else if (x >= w - r && y >= h - r && (mask & GCornerBottomRight)) {
+        cx = w - r; cy = h - r;
+    } else {
+        return false;
+    }
+    double dx = x + 0.5 - cx, dy = y + 0.5 - cy;
+    return dx * dx + dy * dy > (double)r * r;
+}
+
+void graphics_fill_rect(GContext* ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+    g_shim_counts.fill_rect += 1;
+    int16_t r = corner_radius;
+    if (r > rect.size.w / 2) r = rect.size.w / 2;
+    if (r > rect.size.h / 2) r = rect.size.h / 2;
+    for (int16_t y = 0; y < rect.size.h; ++y) {
+        for (int16_t x = 0; x < rect.size.w; ++x) {
+            if (r <= 0 || !outside_corner(x, y, rect.size.w, rect.size.h, r, corner_mask)) {
+                put_pixel(ctx, rect.origin.x + x, rect.origin.y + y, ctx->fill_color);
+            }
+        }
+    }
+}
+
+void graphics_draw_rect(GContext* ctx, GRect rect) {
+    GPoint tl = rect.origin;
+    GPoint br = GPoint(rect.origin.x + rect.size.w - 1, rect.origin.y + rect.size.h - 1);
+    graphics_draw_line(ctx, tl, GPoint(br.x, tl.y));
+    graphics_draw_line(ctx, GPoint(br.x, tl.y), br);
+    graphics_draw_line(ctx, br, GPoint(tl.x, br.y));
+    graphics_draw_line(ctx, GPoint(tl.x, br.y), tl);
+}
+
+void graphics_draw_line(GContext* ctx, GPoint p0, GPoint p1) {
+    g_shim_counts.draw_line += 1;
+    int dx = abs(p1.x - p0.x), sx = p0.x < p1.x ? 1 : -1;
+    int dy = -abs(p1.y - p0.y), sy = p0.y < p1.y ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        put_pixel(ctx, p0.x, p0.y, ctx->stroke_color);
+        if (p0.x == p1.x && p0.y == p1.y) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; p0.x += sx; }
+        if (e2 <= dx) { err += dx; p0.y += sy; }
+    }
+}
+
+void graphics_draw_text(GContext* ctx, const char* text, GFont const font, const GRect box,
+    const GTextOverflowMode overflow_mode, const GTextAlignment alignment, GTextAttributes* text_attributes) {
+    g_shim_counts.draw_text += 1;
+    TextLine lines[kMaxTextLines];
+    int count = wrap_text(text, font, box.size.w, lines);
+    for (int k = 0; k < count; ++k) {
+        int16_t y = box.origin.y + k * font->line_height;
+        if (k > 0 && y + font->line_height > box.origin.y + box.size.h) {
+            break;
+        }
+        int16_t w = lines[k].length * font->advance;
+        int16_t x = box.origin.x;
+        if (alignment == GTextAlignmentCenter) {
+            x += (box.size.w - w) / 2;
+        } else if (alignment == GTextAlignmentRight) {
+            x += box.size.w - w;
+        }
+        for (int16_t c = 0; c < lines[k].length; ++c, x += font->advance) {
+            if (lines[k].text[c] != ' ') {
+                fill_box(ctx, GRect(x + 1, y + font->top, font->advance - 2, font->cap_height), ctx->text_color);
+            }
+        }
+    }
+}
+
+void graphics_draw_bitmap_in_rect(GContext* ctx, const GBitmap* bitmap, GRect rect) {
+    g_shim_counts.draw_bitmap += 1;
+    GRect source = bitmap->bounds;
+    for (int16_t y = 0; y < rect.size.h && y < source.size.h; ++y) {
+        for (int16_t x = 0; x < rect.size.w && x < source.size.w; ++x) {
+            GColor color = { .argb = bitmap_pixel(bitmap, source.origin.x + x, source.origin.y + y) };
+            put_pixel(ctx, rect.origin.x + x, rect.origin.y + y, color);
+        }
+    }
+}
+
+/* The frame buffer is built from the canvas in the platform's own format,
+   and written back to the canvas when it is released. */
+GBitmap* graphics_capture_frame_buffer(GContext* ctx) {
+    g_shim_counts.capture_frame_buffer += 1;
+    if (ctx->frame_buffer) {
+        return NULL;
+    }
+    GBitmapFormat format = PBL_IF_COLOR_ELSE(PBL_IF_ROUND_ELSE(GBitmapFormat8BitCircular, GBitmapFormat8Bit), GBitmapFormat1Bit);
+    ctx->frame_buffer = gbitmap_create_blank(GSize(kWidth, kHeight), format);
+    for (int16_t y = 0; y < kHeight; ++y) {
+        for (int16_t x = 0; x < kWidth; ++x) {
+            set_bitmap_pixel(ctx->frame_buffer, x, y, s_canvas[y][x]);
+        }
+    }
+    return ctx->frame_buffer;
+}
+
+bool graphics_release_frame_buffer(GContext* ctx, GBitmap* buffer) {
+    if (!buffer || buffer != ctx->frame_buffer) {
+        return false;
+    }
+    for (int16_t y = 0; y < kHeight; ++y) {
+        for (int16_t x = 0; x < kWidth; ++x) {
+            if (on_display(x, y)) {
+                s_canvas[y][x] = bitmap_pixel(buffer, x, y);
+            }
+        }
+    }
+    gbitmap_destroy(buffer);
+    ctx->frame_buffer = NULL;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Layers
+// --------------------------------------------------------------------------
+
+struct Layer {
+    GRect frame;
+    GRect bounds;
+    bool hidden;
+    LayerUpdateProc update_proc;
+    Layer* parent;
+    Layer* first_child;
+    Layer* next_sibling;
+    Window* window;
+    uint8_t data[];
+};
+
+static bool s_dirty;
+
+Layer* layer_create_with_data(GRect frame, size_t data_size) {
+    Layer* layer = calloc(1, sizeof(Layer) + data_size);
+    layer->frame = frame;
+    layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+    return layer;
+}
+
+Layer* layer_create(GRect frame) {
+    return layer_create_with_data(frame, 0);
+}
+
+void layer_destroy(Layer* layer) {
+    if (layer) {
+        layer_remove_from_parent(layer);
+        for (Layer* child = layer->first_child; child; child = child->next_sibling) {
+            child->parent = NULL;
+        }
+        free(layer);
+    }
+}
+
+void* layer_get_data(const Layer* layer) {
+    return (void*)layer->data;
+}
+
+void layer_set_update_proc(Layer* layer, LayerUpdateProc update_proc) {
+    layer->update_proc = update_proc;
+}
+
+void layer_mark_dirty(Layer* layer) {
+    s_dirty = true;
+}
+
+GRect layer_get_frame(const Layer* layer) {
+    return layer->frame;
+}
+
+void layer_set_frame(Layer* layer, GRect frame) {
+    layer->frame = frame;
+    layer->bounds.size = frame.size;
+    s_dirty = true;
+}
+
+GRect layer_get_bounds(const Layer* layer) {
+    return layer->bounds;
+}
+
+void layer_set_bounds(Layer* layer, GRect bounds) {
+    layer->bounds = bounds;
+    s_dirty = true;
+}
+
+void layer_add_child(Layer* parent, Layer* child) {
+    layer_remove_from_parent(child);
+    child->parent = parent;
+    child->window = parent->window;
+    Layer** link = &parent->first_child;
+    while (*link) {
+        link = &(*link)->next_sibling;
+    }
+    *link = child;
+    s_dirty = true;
+}
+
+void layer_remove_from_parent(Layer* child) {
+    if (!child->parent) {
+        return;
+    }
+    Layer** link = &child->parent->first_child;
+    while (*link && *link != child) {
+        link = &(*link)->next_sibling;
+    }
+    if (*link) {
+        *link = child->next_sibling;
+    }
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    s_dirty = true;
+}
+
+bool layer_get_hidden(const Layer* layer) {
+    return layer->hidden;
+}
+
+void layer_set_hidden(Layer* layer, bool hidden) {
+    layer->hidden = hidden;
+    s_dirty = true;
+}
+
+Window* layer_get_window(const Layer* layer) {
+    return layer->window;
+}
+
+GRect layer_convert_rect_to_screen(const Layer* layer, GRect rect) {
+    for (; layer; layer = layer->parent) {
+        rect.origin.x += layer->frame.origin.x + layer->bounds.origin.x;
+        rect.origin.y += layer->frame.origin.y + layer->bounds.origin.y;
+    }
+    return rect;
+}
+
+static void render_layer(Layer* layer, GPoint origin, GRect clip) {
+    if (layer->hidden) {
+        return;
+    }
+    GPoint frame_origin = GPoint(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y);
+    GRect frame = { frame_origin, layer->frame.size };
+    clip = grect_intersect(clip, frame);
+    GPoint bounds_origin = GPoint(frame_origin.x + layer->bounds.origin.x, frame_origin.y + layer->bounds.origin.y);
+    if (layer->update_proc) {
+        s_context.origin = bounds_origin;
+        s_context.clip = clip;
+        g_shim_counts.update_procs += 1;
+        layer->update_proc(layer, &s_context);
+    }
+    for (Layer* child = layer->first_child; child; child = child->next_sibling) {
+        render_layer(child, bounds_origin, clip);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Windows
+// --------------------------------------------------------------------------
+
+struct Window {
+    Layer* root;
+    WindowHandlers handlers;
+    ClickConfigProvider click_config_provider;
+    GColor background_color;
+    bool loaded;
+    ClickHandler single_click[NUM_BUTTONS];
+    ClickHandler long_click_down[NUM_BUTTONS];
+    ClickHandler long_click_up[NUM_BUTTONS];
+};
+
+enum { kMaxWindows = 8, kTransitionMs = 300 };
+
+static Window* s_window_stack[kMaxWindows];
+static int s_window_count;
+static Window* s_configuring_window;
+static int64_t s_transition_end_ms;
+
+Window* window_create(void) {
+    Window* window = calloc(1, sizeof(Window));
+    window->background_color = GColorWhite;
+    window->root = layer_create(GRect(0, 0, kWidth, kHeight));
+    window->root->window = window;
+    return window;
+}
+
+void window_destroy(Window* window) {
+    if (!window) {
+        return;
+    }
+    window_stack_remove(window, false);
+    layer_destroy(window->root);
+    free(window);
+}
+
+void window_set_window_handlers(Window* window, WindowHandlers handlers) {
+    window->handlers = handlers;
+}
+
+void window_set_background_color(Window* window, GColor background_color) {
+    window->background_color = background_color;
+}
+
+void window_set_click_config_provider(Window* window, ClickConfigProvider click_config_provider) {
+    window->click_config_provider = click_config_provider;
+}
+
+Layer* window_get_root_layer(const Window* window) {
+    return window->root;
+}
+
+bool window_is_loaded(Window* window) {
+    return window->loaded;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+    s_configuring_window->single_click[button_id] = handler;
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler) {
+    s_configuring_window->single_click[button_id] = handler;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler) {
+    s_configuring_window->long_click_down[button_id] = down_handler;
+    s_configuring_window->long_click_up[button_id] = up_handler;
+}
+
+Window* window_stack_get_top_window(void) {
+    return s_window_count > 0 ? s_window_stack[s_window_count - 1] : NULL;
+}
+
+bool window_stack_contains_window(Window* window) {
+    for (int k = 0; k < s_window_count; ++k) {
+        if (s_window_stack[k] == window) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void start_transition(bool animated) {
+    s_transition_end_ms = animated ? s_now_ms + kTransitionMs : s_now_ms;
+    s_dirty = true;
+}
+
+void window_stack_push(Window* window, bool animated) {
+    if (!window || window_stack_contains_window(window) || s_window_count == kMaxWindows) {
+        return;
+    }
+    Window* previous = window_stack_get_top_window();
+    s_window_stack[s_window_count++] = window;
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->handlers.load) window->handlers.load(window);
+    }
+    if (window->click_config_provider) {
+        s_configuring_window = window;
+        window->click_config_provider(NULL);
+        s_configuring_window = NULL;
+    }
+    if (previous && previous->handlers.disappear) previous->handlers.disappear(previous);
+    if (window->handlers.appear) window->handlers.appear(window);
+    start_transition(animated);
+}
+
+bool window_stack_remove(Window* window, bool animated) {
+    int k = 0;
+    while (k < s_window_count && s_window_stack[k] != window) {
+        ++k;
+    }
+    if (k == s_window_count) {
+        return false;
+    }
+    bool was_top = k == s_window_count - 1;
+    memmove(&s_window_stack[k], &s_window_stack[k + 1], (s_window_count - k - 1) * sizeof(Window*));
+    s_window_count -= 1;
+    if (was_top && window->handlers.disappear) window->handlers.disappear(window);
+    window->loaded = false;
+    if (window->handlers.unload) window->handlers.unload(window);
+    Window* top = window_stack_get_top_window();
+    if (was_top && top) {
+        if (top->handlers.appear) top->handlers.appear(top);
+        start_transition(animated);
+    }
+    return true;
+}
+
+void window_stack_pop_all(const bool animated) {
+    while (s_window_count > 0) {
+        window_stack_remove(s_window_stack[s_window_count - 1], animated);
+    }
+}
+
+void shim_render_offset(GPoint offset) {
+    Window* window = window_stack_get_top_window();
+    shim_canvas_clear(GColorBlack);
+    if (!window) {
+        return;
+    }
+    GRect clip = GRect(offset.x, offset.y, kWidth, kHeight);
+    s_context.origin = offset;
+    s_context.clip = grect_intersect(clip, GRect(0, 0, kWidth, kHeight));
+    fill_box(&s_context, GRect(0, 0, kWidth, kHeight), window->background_color);
+    render_layer(window->root, offset, s_context.clip);
+    s_dirty = false;
+}
+
+/* During a transition the incoming window slides in from the right. */
+void shim_render(void) {
+    int64_t remaining = s_transition_end_ms - s_now_ms;
+    int16_t x = remaining > 0 ? (int16_t)(kWidth * remaining / kTransitionMs) : 0;
+    shim_render_offset(GPoint(x, 0));
+}
+
+void shim_click(ButtonId button, bool long_press) {
+    Window* window = window_stack_get_top_window();
+    if (!window) {
+        return;
+    }
+    if (long_press && window->long_click_down[button]) {
+        window->long_click_down[button](NULL, NULL);
+        if (window->long_click_up[button]) {
+            window->long_click_up[button](NULL, NULL);
+        }
+    } else if (window->single_click[button]) {
+        window->single_click[button](NULL, NULL);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Time, timers and the event loop
+// --------------------------------------------------------------------------
+
+struct AppTimer {
+    int64_t fire_ms;
+    AppTimerCallback callback;
+    void* data;
+    bool active;
+    AppTimer* next;
+};
+
+static AppTimer* s_timers;
+static bool s_clock_24h = true;
+static AppLaunchReason s_launch_reason = APP_LAUNCH_USER;
+static uint32_t s_launch_args;
+
+/* Timers are never freed, so that a stale handle is just inactive. */
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* callback_data) {
+    AppTimer* timer = calloc(1, sizeof(AppTimer));
+    timer->fire_ms = s_now_ms + timeout_ms;
+    timer->callback = callback;
+    timer->data = callback_data;
+    timer->active = true;
+    timer->next = s_timers;
+    s_timers = timer;
+    return timer;
+}
+
+bool app_timer_reschedule(AppTimer* timer_handle, uint32_t new_timeout_ms) {
+    if (!timer_handle || !timer_handle->active) {
+        return false;
+    }
+    timer_handle->fire_ms = s_now_ms + new_timeout_ms;
+    return true;
+}
+
+void app_timer_cancel(AppTimer* timer_handle) {
+    if (timer_handle) {
+        timer_handle->active = false;
+    }
+}
+
+void shim_set_time(time_t seconds) {
+    s_now_ms = (int64_t)seconds * 1000;
+}
+
+void shim_advance_ms(uint32_t ms) {
+    int64_t until = s_now_ms + ms;
+    for (;;) {
+        AppTimer* next = NULL;
+        for (AppTimer* timer = s_timers; timer; timer = timer->next) {
+            if (timer->active && timer->fire_ms <= until && (!next || timer->fire_ms < next->fire_ms)) {
+                next = timer;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        if (next->fire_ms > s_now_ms) {
+            s_now_ms = next->fire_ms;
+        }
+        next->active = false;
+        next->callback(next->data);
+    }
+    s_now_ms = until;
+}
+
+void shim_set_clock_24h(bool clock_24h) {
+    s_clock_24h = clock_24h;
+}
+
+void shim_set_launch(AppLaunchReason reason, uint32_t args) {
+    s_launch_reason = reason;
+    s_launch_args = args;
+}
+
+uint16_t time_ms(time_t* tloc, uint16_t* out_ms) {
+    if (tloc) {
+        *tloc = (time_t)(s_now_ms / 1000);
+    }
+    if (out_ms) {
+        *out_ms = (uint16_t)(s_now_ms % 1000);
+    }
+    return (uint16_t)(s_now_ms % 1000);
+}
+
+time_t time_start_of_today(void) {
+    time_t now = (time_t)(s_now_ms / 1000);
+    struct tm local;
+    localtime_r(&now, &local);
+    local.tm_hour = 0;
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    return mktime(&local);
+}
+
+bool clock_is_24h_style(void) {
+    return s_clock_24h;
+}
+
+/* The test drives the app from here, between main()'s setup and teardown. */
+void (*g_shim_event_loop)(void);
+
+void app_event_loop(void) {
+    if (g_shim_event_loop) {
+        g_shim_event_loop();
+    }
+}
+
+AppLaunchReason launch_reason(void) {
+    return s_launch_reason;
+}
+
+uint32_t launch_get_args(void) {
+    return s_launch_args;
+}
+
+void exit_reason_set(AppExitReason reason) {
+}
+
+size_t heap_bytes_free(void) {
+    return PBL_IF_COLOR_ELSE(48 * 1024, 16 * 1024);
+}
+
+size_t heap_bytes_used(void) {
+    return 4 * 1024;
+}
+
+// --------------------------------------------------------------------------
+// Persistent storage
+// --------------------------------------------------------------------------
+
+enum { kPersistKeys = 64 };
+
+static struct {
+    bool exists;
+    int size;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} s_persist[kPersistKeys];
+
+bool persist_exists(const uint32_t key) {
+    return key < kPersistKeys && s_persist[key].exists;
+}
+
+int persist_get_size(const uint32_t key) {
+    return persist_exists(key) ? s_persist[key].size : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size) {
+    if (!persist_exists(key)) {
+        return E_DOES_NOT_EXIST;
+    }
+    int size = s_persist[key].size < (int)buffer_size ? s_persist[key].size : (int)buffer_size;
+    memcpy(buffer, s_persist[key].data, size);
+    return size;
+}
+
+int persist_write_data(const uint32_t key, const void* data, const size_t size) {
+    if (key >= kPersistKeys) {
+        return E_DOES_NOT_EXIST;
+    }
+    int n = size < PERSIST_DATA_MAX_LENGTH ? (int)size : PERSIST_DATA_MAX_LENGTH;
+    s_persist[key].exists = true;
+    s_persist[key].size = n;
+    memcpy(s_persist[key].data, data, n);
+    return n;
+}
+
+int persist_delete(const uint32_t key) {
+    if (!persist_exists(key)) {
+        return E_DOES_NOT_EXIST;
+    }
+    s_persist[key].exists = false;
+    return 0;
+}
+
+void shim_persist_clear(void) {
+    memset(s_persist, 0, sizeof s_persist);
+}
+
+// --------------------------------------------------------------------------
+// Dictionaries and AppMessage
+// --------------------------------------------------------------------------
+
+/* A dictionary is a count byte followed by the tuples, as on the watch. */
+enum { kTupleHeader = 7, kDictCapacity = 2048 };
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+    uint32_t total = 1;
+    va_list args;
+    va_start(args, tuple_count);
+    for (uint8_t k = 0; k < tuple_count; ++k) {
+        total += kTupleHeader + va_arg(args, uint32_t);
+    }
+    va_end(args);
+    return total;
+}
+
+Tuple* dict_read_first(DictionaryIterator* iter) {
+    iter->cursor = iter->begin + 1;
+    return iter->begin[0] > 0 ? (Tuple*)iter->cursor : NULL;
+}
+
+Tuple* dict_read_next(DictionaryIterator* iter) {
+    Tuple* tuple = (Tuple*)iter->cursor;
+    iter->cursor += kTupleHeader + tuple->length;
+    return iter->cursor < iter->end ? (Tuple*)iter->cursor : NULL;
+}
+
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key) {
+    DictionaryIterator copy = *iter;
+    for (Tuple* tuple = dict_read_first(&copy); tuple; tuple = dict_read_next(&copy)) {
+        if (tuple->key == key) {
+            return tuple;
+        }
+    }
+    return NULL;
+}
+
+static DictionaryResult dict_append(DictionaryIterator* iter, uint32_t key, TupleType type, const void* value, uint16_t length) {
+    if (iter->end + kTupleHeader + length > iter->begin + kDictCapacity) {
+        return DICT_NOT_ENOUGH_STORAGE;
+    }
+    Tuple* tuple = (Tuple*)iter->end;
+    tuple->key = key;
+    tuple->type = type;
+    tuple->length = length;
+    memcpy(tuple->value->data, value, length);
+    iter->end += kTupleHeader + length;
+    iter->begin[0] += 1;
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size) {
+    return dict_append(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring) {
+    return dict_append(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed) {
+    return dict_append(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value) {
+    return dict_append(iter, key, TUPLE_UINT, &value, sizeof value);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value) {
+    return dict_append(iter, key, TUPLE_INT, &value, sizeof value);
+}
+
+static uint8_t s_inbox_buffer[kDictCapacity];
+static uint8_t s_outbox_buffer[kDictCapacity];
+static uint8_t s_sent_buffer[kDictCapacity];
+static DictionaryIterator s_inbox;
+static DictionaryIterator s_outbox;
+static DictionaryIterator s_sent;
+static bool s_outbox_in_flight;
+
+static void dict_reset(DictionaryIterator* iter, uint8_t* buffer) {
+    iter->begin = buffer;
+    iter->end = buffer + 1;
+    iter->cursor = buffer + 1;
+    buffer[0] = 0;
+}
+
+DictionaryIterator* shim_dict_begin(void) {
+    dict_reset(&s_inbox, s_inbox_buffer);
+    return &s_inbox;
+}
+
+void shim_dict_add_int(uint32_t key, int32_t value) {
+    dict_write_int32(&s_inbox, key, value);
+}
+
+void shim_dict_add_data(uint32_t key, const uint8_t* data, uint16_t length) {
+    dict_write_data(&s_inbox, key, data, length);
+}
+
+void shim_dict_add_cstring(uint32_t key, const char* text) {
+    dict_write_cstring(&s_inbox, key, text);
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator** iterator) {
+    if (s_outbox_in_flight) {
+        return APP_MSG_BUSY;
+    }
+    dict_reset(&s_outbox, s_outbox_buffer);
+    *iterator = &s_outbox;
+    return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    memcpy(s_sent_buffer, s_outbox_buffer, sizeof s_sent_buffer);
+    s_sent.begin = s_sent_buffer;
+    s_sent.end = s_sent_buffer + (s_outbox.end - s_outbox.begin);
+    s_sent.cursor = s_sent.begin + 1;
+    s_outbox_in_flight = true;
+    return APP_MSG_OK;
+}
+
+DictionaryIterator* shim_last_outbox(void) {
+    return s_sent.begin ? &s_sent : NULL;
+}
+
+enum { kMaxMessageHandlers = 8 };
+
+/* The handler tables share a layout, so that unsubscribing can clear an
+   entry in any of them. */
+static struct {
+    AppMessageInboxReceived callback;
+    void* context;
+} s_inbox_handlers[kMaxMessageHandlers];
+
+static struct {
+    AppMessageOutboxSent callback;
+    void* context;
+} s_sent_handlers[kMaxMessageHandlers];
+
+static struct {
+    AppMessageOutboxFailed callback;
+    void* context;
+} s_failed_handlers[kMaxMessageHandlers];
+
+void events_app_message_request_inbox_size(uint32_t size) {
+}
+
+void events_app_message_request_outbox_size(uint32_t size) {
+}
+
+EventHandle events_app_message_register_inbox_received(AppMessageInboxReceived received_callback, void* context) {
+    for (int k = 0; k < kMaxMessageHandlers; ++k) {
+        if (!s_inbox_handlers[k].callback) {
+            s_inbox_handlers[k].callback = received_callback;
+            s_inbox_handlers[k].context = context;
+            return &s_inbox_handlers[k];
+        }
+    }
+    return NULL;
+}
+
+EventHandle events_app_message_register_outbox_sent(AppMessageOutboxSent sent_callback, void* context) {
+    for (int k = 0; k < kMaxMessageHandlers; ++k) {
+        if (!s_sent_handlers[k].callback) {
+            s_sent_handlers[k].callback = sent_callback;
+            s_sent_handlers[k].context = context;
+            return &s_sent_handlers[k];
+        }
+    }
+    return NULL;
+}
+
+EventHandle events_app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback, void* context) {
+    for (int k = 0; k < kMaxMessageHandlers; ++k) {
+        if (!s_failed_handlers[k].callback) {
+            s_failed_handlers[k].callback = failed_callback;
+            s_failed_handlers[k].context = context;
+            return &s_failed_handlers[k];
+        }
+    }
+    return NULL;
+}
+
+void events_app_message_unsubscribe(EventHandle handle) {
+    if (handle) {
+        memset(handle, 0, sizeof s_inbox_handlers[0]);
+    }
+}
+
+AppMessageResult events_app_message_open(void) {
+    return APP_MSG_OK;
+}
+
+void shim_deliver(void) {
+    for (int k = 0; k < kMaxMessageHandlers; ++k) {
+        if (s_inbox_handlers[k].callback) {
+            s_inbox_handlers[k].callback(&s_inbox, s_inbox_handlers[k].context);
+        }
+    }
+}
+
+void shim_outbox_complete(bool delivered) {
+    if (!s_outbox_in_flight) {
+        return;
+    }
+    /* As on the watch, the outbox is free again by the time the handlers
+       run, so that they can send the next message. */
+    s_outbox_in_flight = false;
+    for (int k = 0; k < kMaxMessageHandlers; ++k) {
+        if (delivered && s_sent_handlers[k].callback) {
+            s_sent_handlers[k].callback(&s_sent, s_sent_handlers[k].context);
+        } else if (!delivered && s_failed_handlers[k].callback) {
+            s_failed_handlers[k].callback(&s_sent, APP_MSG_SEND_REJECTED, s_failed_handlers[k].context);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// App glances
+// --------------------------------------------------------------------------
+
+struct AppGlanceReloadSession {
+    size_t slices;
+};
+
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession* session, AppGlanceSlice slice) {
+    session->slices += 1;
+    return APP_GLANCE_RESULT_SUCCESS;
+}
+
+void app_glance_reload(AppGlanceReloadCallback callback, void* context) {
+    AppGlanceReloadSession session = { 0 };
+    if (callback) {
+        callback(&session, 8, context);
+    }
+}
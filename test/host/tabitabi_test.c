@@ -0,0 +1,556 @@
+/* Unit tests for the watch app, built on the host for each platform.
+
+   The app's sources are included, so that the tests can call its static
+   functions and inspect its state directly. */
+
+#define main tabitabi_main
+#include "main.c"
+#undef main
+
+static int s_checks;
+static int s_failures;
+
+#define CHECK(cond) do { \
+        s_checks += 1; \
+        if (!(cond)) { \
+            s_failures += 1; \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+        } \
+    } while (0)
+
+static const time_t kStartTime = 1772443800; // 2026-03-02 09:30 UTC, a Monday.
+
+static int32_t start_hour(void) {
+    return kStartTime / kOneHour;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint32_t value) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+/* Encode a REVIEW_FORECAST chunk of entries an hour apart from the hour
+   after the base hour, each with a count of its own hour offset from the
+   first, plus one. */
+static uint16_t encode_hourly_from(uint8_t* chunk, bool append, int32_t base_hour, int first, int count) {
+    uint8_t* p = chunk;
+    *p++ = kForecastFormatVersion;
+    *p++ = append ? kForecastAppend : 0;
+    p = put_varint(p, base_hour);
+    for (int k = 0; k < count; ++k) {
+        p = put_varint(p, 1);
+        p = put_varint(p, first + k + 1);
+    }
+    return p - chunk;
+}
+
+/* The same, for a forecast that starts at the start hour, continued from
+   the given entry. */
+static uint16_t encode_hourly(uint8_t* chunk, bool append, int first, int count) {
+    return encode_hourly_from(chunk, append, start_hour() + first, first, count);
+}
+
+/* A summary at the start hour, with the given number of hourly entries from
+   the next hour on. */
+static void fill_summary(StudySummary* q, int count) {
+    uint8_t chunk[kForecastCapacity * 4 + 8];
+    memset(q, 0, sizeof *q);
+    q->epoch_hour = start_hour();
+    uint16_t length = encode_hourly(chunk, false, 0, count);
+    CHECK(decode_forecast(q, chunk, length));
+}
+
+/* Whether the entries are one an hour from the given hour, with the counts
+   of encode_hourly(), starting from the given count. */
+static bool is_hourly(const StudySummary* q, int32_t hour, int count) {
+    for (int k = 0; k < q->forecast_length; ++k) {
+        if (forecast_hour(q, k) != hour + k || forecast_entry(q, k)->count != count + k) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void age_to_hour(StudySummary* q, int32_t hour) {
+    shim_set_time(hour * kOneHour + 30 * kOneMinute);
+    age_summary(q);
+}
+
+// --------------------------------------------------------------------------
+// The forecast ring buffer
+// --------------------------------------------------------------------------
+
+static void test_forecast_head_wraps(void) {
+    StudySummary q;
+    fill_summary(&q, kForecastCapacity);
+    CHECK(q.forecast_length == kForecastCapacity);
+    CHECK(q.forecast_head == 0);
+
+    /* Expire all but a day of entries, then append as many again, so that
+       the entries run past the end of the buffer and around to its start. */
+    int expired = kForecastCapacity - 24;
+    age_to_hour(&q, start_hour() + expired);
+    CHECK(q.forecast_head == expired);
+    CHECK(q.forecast_length == 24);
+
+    uint8_t chunk[kForecastCapacity * 4 + 8];
+    uint16_t length = encode_hourly(chunk, true, kForecastCapacity, expired);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == kForecastCapacity);
+    CHECK(q.forecast_head + q.forecast_length > kForecastCapacity);
+    CHECK(q.base_hour == start_hour());
+    CHECK(is_hourly(&q, start_hour() + expired + 1, expired + 1));
+
+    /* The entry after the last slot of the buffer is in its first slot. */
+    int last_slot = kForecastCapacity - 1 - q.forecast_head;
+    CHECK(forecast_entry(&q, last_slot) == &q.forecast[kForecastCapacity - 1]);
+    CHECK(forecast_entry(&q, last_slot + 1) == &q.forecast[0]);
+}
+
+static void test_age_summary_across_wrap(void) {
+    StudySummary q;
+    fill_summary(&q, kForecastCapacity);
+    age_to_hour(&q, start_hour() + kForecastCapacity - 4);
+    uint8_t chunk[kForecastCapacity * 4 + 8];
+    uint16_t length = encode_hourly(chunk, true, kForecastCapacity, 20);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_head == kForecastCapacity - 4);
+    CHECK(q.forecast_length == 24);
+
+    /* Expire the four entries at the end of the buffer and six more from its
+       start, with the forecast scrolled down past some of them. */
+    uint16_t review_count = q.review_count;
+    s_forecast_scroll = 7;
+    age_to_hour(&q, start_hour() + kForecastCapacity + 6);
+    CHECK(q.forecast_head == 6);
+    CHECK(q.forecast_length == 14);
+    CHECK(q.epoch_hour == start_hour() + kForecastCapacity + 6);
+    CHECK(is_hourly(&q, start_hour() + kForecastCapacity + 7, kForecastCapacity + 7));
+    CHECK(s_forecast_scroll == 0);
+
+    /* The expired counts are kForecastCapacity - 3 to kForecastCapacity + 6. */
+    CHECK(q.review_count == review_count + 10 * kForecastCapacity + 15);
+
+    /* Aging again within the same hour changes nothing. */
+    age_to_hour(&q, start_hour() + kForecastCapacity + 6);
+    CHECK(q.forecast_head == 6);
+    CHECK(q.forecast_length == 14);
+    s_forecast_scroll = 0;
+}
+
+static void test_decode_appends_after_aging(void) {
+    StudySummary q;
+    fill_summary(&q, 10);
+    age_to_hour(&q, start_hour() + 4);
+    CHECK(q.forecast_length == 6);
+    CHECK(q.forecast_head == 4);
+
+    /* An appended chunk continues from the last entry, not the epoch hour,
+       and keeps the base hour of the forecast. */
+    uint8_t chunk[64];
+    uint16_t length = encode_hourly(chunk, true, 10, 5);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == 11);
+    CHECK(q.base_hour == start_hour());
+    CHECK(is_hourly(&q, start_hour() + 5, 5));
+    CHECK(forecast_entry(&q, 10)->hour_offset == 15);
+
+    /* A chunk that is not appended replaces the forecast, and its base is
+       the epoch hour the summary has been aged to. */
+    length = encode_hourly_from(chunk, false, start_hour() + 4, 0, 3);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == 3);
+    CHECK(q.forecast_head == 0);
+    CHECK(q.base_hour == start_hour() + 4);
+    CHECK(is_hourly(&q, start_hour() + 5, 1));
+}
+
+/* Aging between two chunks may expire the whole forecast, but the appended
+   chunk still lands on its own hours, not on the hours after the epoch. */
+static void test_decode_appends_to_expired_forecast(void) {
+    StudySummary q;
+    fill_summary(&q, 3);
+    uint16_t review_count = q.review_count;
+    age_to_hour(&q, start_hour() + 5);
+    CHECK(q.forecast_length == 0);
+    CHECK(q.review_count == review_count + 1 + 2 + 3);
+
+    uint8_t chunk[64];
+    uint16_t length = encode_hourly(chunk, true, 3, 5);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == 5);
+    CHECK(is_hourly(&q, start_hour() + 4, 4));
+
+    /* The entries that are already due are counted at the next aging. */
+    age_summary(&q);
+    CHECK(q.forecast_length == 3);
+    CHECK(is_hourly(&q, start_hour() + 6, 6));
+    CHECK(q.review_count == review_count + 1 + 2 + 3 + 4 + 5);
+}
+
+static void test_decode_truncates_at_capacity(void) {
+    StudySummary q;
+    fill_summary(&q, kForecastCapacity - 2);
+
+    uint8_t chunk[64];
+    uint16_t length = encode_hourly(chunk, true, kForecastCapacity - 2, 5);
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == kForecastCapacity);
+    CHECK(is_hourly(&q, start_hour() + 1, 1));
+
+    /* A full forecast takes no more entries. */
+    CHECK(decode_forecast(&q, chunk, length));
+    CHECK(q.forecast_length == kForecastCapacity);
+    CHECK(forecast_hour(&q, kForecastCapacity - 1) == start_hour() + kForecastCapacity);
+}
+
+static void test_malformed_chunk_leaves_forecast(void) {
+    StudySummary q;
+    fill_summary(&q, 10);
+    age_to_hour(&q, start_hour() + 2);
+    StudySummary before = q;
+
+    /* Good entries followed by one cut off in its count varint. */
+    uint8_t chunk[64];
+    uint16_t length = encode_hourly_from(chunk, false, q.epoch_hour, 0, 3);
+    chunk[length++] = 1;
+    chunk[length++] = 0x80;
+    CHECK(!decode_forecast(&q, chunk, length));
+    CHECK(memcmp(&q, &before, sizeof q) == 0);
+
+    chunk[1] = kForecastAppend;
+    CHECK(!decode_forecast(&q, chunk, length));
+    CHECK(memcmp(&q, &before, sizeof q) == 0);
+
+    /* A chunk cut off in its base hour. */
+    CHECK(!decode_forecast(&q, chunk, 3));
+    CHECK(memcmp(&q, &before, sizeof q) == 0);
+
+    /* A count too large for the forecast entries. */
+    length = encode_hourly_from(chunk, false, q.epoch_hour, 0, 2);
+    uint8_t* p = put_varint(chunk + length, 1);
+    p = put_varint(p, UINT16_MAX + 1);
+    CHECK(!decode_forecast(&q, chunk, p - chunk));
+    CHECK(memcmp(&q, &before, sizeof q) == 0);
+
+    p = put_varint(chunk + length, 1);
+    p = put_varint(p, UINT16_MAX);
+    CHECK(decode_forecast(&q, chunk, p - chunk));
+    CHECK(q.forecast_length == 3);
+    CHECK(forecast_entry(&q, 2)->count == UINT16_MAX);
+}
+
+// --------------------------------------------------------------------------
+// Round layout
+// --------------------------------------------------------------------------
+
+#if defined(PBL_ROUND)
+static int16_t isqrt(int32_t n) {
+    int32_t r = 0;
+    while ((r + 1) * (r + 1) <= n) {
+        r += 1;
+    }
+    return r;
+}
+
+static void test_round_half_width_table(void) {
+    CHECK(ARRAY_LENGTH(kRoundHalfWidth) == 91);
+    for (int dy = 0; dy < (int)ARRAY_LENGTH(kRoundHalfWidth); ++dy) {
+        int16_t expected = dy <= 88 ? isqrt(88 * 88 - dy * dy) : 0;
+        if (kRoundHalfWidth[dy] != expected) {
+            fprintf(stderr, "kRoundHalfWidth[%d] is %d, not %d\n", dy, kRoundHalfWidth[dy], expected);
+        }
+        CHECK(kRoundHalfWidth[dy] == expected);
+    }
+
+    /* The display is symmetric about its center line, and zero beyond it. */
+    for (int16_t dy = 0; dy <= 100; ++dy) {
+        CHECK(round_half_width(kRoundCenter - dy) == round_half_width(kRoundCenter + dy));
+    }
+    CHECK(round_half_width(kRoundCenter) == 88);
+    CHECK(round_half_width(-10) == 0);
+    CHECK(round_reach(88) == 0);
+    CHECK(round_reach(1) == 87);
+}
+#endif
+
+// --------------------------------------------------------------------------
+// Persistent storage
+// --------------------------------------------------------------------------
+
+static void test_summary_round_trip(void) {
+    shim_persist_clear();
+    StudySummary q;
+    fill_summary(&q, kForecastCapacity);
+    age_to_hour(&q, start_hour() + 100);
+    uint8_t chunk[64];
+    uint16_t length = encode_hourly(chunk, true, kForecastCapacity, 10);
+    CHECK(decode_forecast(&q, chunk, length));
+    q.lesson_count = 12;
+    save_summary(&q);
+
+    /* The loaded forecast starts from a head of zero. */
+    StudySummary loaded;
+    memset(&loaded, 0, sizeof loaded);
+    CHECK(load_summary(&loaded));
+    CHECK(loaded.lesson_count == 12);
+    CHECK(loaded.review_count == q.review_count);
+    CHECK(loaded.epoch_hour == q.epoch_hour);
+    CHECK(loaded.base_hour == q.base_hour);
+    CHECK(loaded.forecast_head == 0);
+    CHECK(loaded.forecast_length == q.forecast_length);
+    CHECK(is_hourly(&loaded, start_hour() + 101, 101));
+}
+
+static void test_short_read_leaves_summary(void) {
+    shim_persist_clear();
+    StudySummary q;
+    fill_summary(&q, kForecastCapacity);
+    save_summary(&q);
+
+    /* Lose the end of the last run of forecast entries. */
+    int last_key = kPersistSummaryForecast + (kForecastCapacity - 1) / kPersistForecastEntries;
+    ForecastEntry entries[kPersistForecastEntries];
+    int size = persist_read_data(last_key, entries, sizeof entries);
+    CHECK(size > (int)sizeof(ForecastEntry));
+    persist_write_data(last_key, entries, size - sizeof(ForecastEntry));
+
+    StudySummary loaded;
+    fill_summary(&loaded, 5);
+    age_to_hour(&loaded, start_hour() + 2);
+    loaded.lesson_count = 7;
+    StudySummary before = loaded;
+    CHECK(!load_summary(&loaded));
+    CHECK(memcmp(&loaded, &before, sizeof loaded) == 0);
+
+    /* A missing header fails the same way. */
+    persist_delete(kPersistSummaryHeader);
+    CHECK(!load_summary(&loaded));
+    CHECK(memcmp(&loaded, &before, sizeof loaded) == 0);
+}
+
+// --------------------------------------------------------------------------
+// Histogram capture
+// --------------------------------------------------------------------------
+
+static GColor s_canvas_copy[PBL_DISPLAY_HEIGHT][PBL_DISPLAY_WIDTH];
+
+static void copy_canvas(void) {
+    for (int16_t y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+        for (int16_t x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+            s_canvas_copy[y][x] = shim_canvas_pixel(x, y);
+        }
+    }
+}
+
+static int canvas_differences(void) {
+    int differences = 0;
+    for (int16_t y = 0; y < PBL_DISPLAY_HEIGHT; ++y) {
+        for (int16_t x = 0; x < PBL_DISPLAY_WIDTH; ++x) {
+            differences += shim_canvas_pixel(x, y).argb != s_canvas_copy[y][x].argb;
+        }
+    }
+    return differences;
+}
+
+/* Push the main screen, animated, with the histogram of an hourly summary
+   in view. */
+static void show_histogram(int count) {
+    s_main_screen = create_main_screen();
+    window_stack_push(s_main_screen, true);
+    fill_summary(&s_summary, count);
+    cache_study_summary(&s_summary);
+    s_forecast_view = kForecastViewHistogram;
+}
+
+static void hide_histogram(void) {
+    window_destroy(s_main_screen);
+    s_main_screen = NULL;
+    s_forecast_view = kForecastViewRows;
+    memset(&s_histogram, 0, sizeof s_histogram);
+}
+
+/* The histogram is captured only once the main screen has settled, and the
+   captured bitmap draws the same pixels as the rendering it was taken from,
+   whatever the frame buffer format: 1 bit on aplite and diorite, 8 bits on
+   basalt, and the visible row spans on chalk. */
+static void test_histogram_capture_matches_render(void) {
+    show_histogram(20);
+
+    shim_reset_counts();
+    shim_render();
+    CHECK(g_shim_counts.capture_frame_buffer == 0);
+    CHECK(!s_histogram_captured);
+
+    shim_advance_ms(kMainScreenSettleMs);
+    shim_reset_counts();
+    shim_render();
+    CHECK(g_shim_counts.capture_frame_buffer == 1);
+    CHECK(s_histogram_captured);
+    copy_canvas();
+
+    shim_reset_counts();
+    shim_render();
+    CHECK(g_shim_counts.capture_frame_buffer == 0);
+    CHECK(g_shim_counts.draw_bitmap == 1);
+    CHECK(canvas_differences() == 0);
+
+    hide_histogram();
+}
+
+/* A histogram that changes while another window covers the main screen is
+   rendered, not captured, until the main screen has settled on top again. */
+static void test_histogram_not_captured_while_covered(void) {
+    show_histogram(20);
+    shim_advance_ms(kMainScreenSettleMs);
+    shim_render();
+    CHECK(s_histogram_captured);
+
+    Window* cover = window_create();
+    window_stack_push(cover, true);
+    fill_summary(&s_summary, 10);
+    cache_study_summary(&s_summary);
+    CHECK(!s_histogram_captured);
+    shim_advance_ms(kMainScreenSettleMs);
+
+    window_stack_remove(cover, true);
+    window_destroy(cover);
+    shim_reset_counts();
+    shim_render();
+    CHECK(g_shim_counts.capture_frame_buffer == 0);
+    CHECK(!s_histogram_captured);
+
+    shim_advance_ms(kMainScreenSettleMs);
+    shim_reset_counts();
+    shim_render();
+    CHECK(g_shim_counts.capture_frame_buffer == 1);
+    CHECK(s_histogram_captured);
+
+    hide_histogram();
+}
+
+// --------------------------------------------------------------------------
+// Launch
+// --------------------------------------------------------------------------
+
+/* Run the app's main() with the given check as its event loop. */
+static void run_app(void (*check)(void)) {
+    g_shim_event_loop = check;
+    shim_set_launch(APP_LAUNCH_USER, 0);
+    tabitabi_main();
+    g_shim_event_loop = NULL;
+}
+
+/* The phone never answers, but the saved summary is on display. */
+static void check_timeout_with_summary(void) {
+    CHECK(window_stack_get_top_window() == s_main_screen);
+    shim_advance_ms(6000);
+    CHECK(window_stack_get_top_window() == s_main_screen);
+    CHECK(!window_stack_contains_window(s_message_screen));
+    CHECK(s_offline);
+    CHECK(!layer_get_hidden(s_offline_layer));
+
+    shim_render();
+    GColor badge = shim_canvas_pixel(s_offline_box.origin.x + 1, s_offline_box.origin.y + s_offline_box.size.h / 2);
+    CHECK(badge.argb == kOfflineColor.argb);
+
+    /* A later summary clears the badge. */
+    shim_dict_begin();
+    shim_dict_add_int(MESSAGE_KEY_SUCCESS, 1);
+    shim_deliver();
+    CHECK(!s_offline);
+    CHECK(layer_get_hidden(s_offline_layer));
+    CHECK(dict_find(shim_last_outbox(), MESSAGE_KEY_DIAGNOSTICS));
+    shim_outbox_complete(true);
+}
+
+static void test_timeout_keeps_saved_summary(void) {
+    shim_persist_clear();
+    StudySummary q;
+    fill_summary(&q, 10);
+    save_summary(&q);
+    run_app(check_timeout_with_summary);
+}
+
+/* The phone never answers, and there is nothing saved to show. */
+static void check_timeout_without_summary(void) {
+    CHECK(window_stack_get_top_window() == s_load_screen);
+    shim_advance_ms(6000);
+    CHECK(window_stack_get_top_window() == s_message_screen);
+    CHECK(!window_stack_contains_window(s_main_screen));
+    CHECK(strcmp(s_message_text_buffer, "Host unavailable.") == 0);
+}
+
+static void test_timeout_without_summary(void) {
+    shim_persist_clear();
+    run_app(check_timeout_without_summary);
+}
+
+/* The saved summary arrives while the refresh request is in flight, and the
+   diagnostics follow it once the phone has acknowledged the request. */
+static void check_diagnostics_wait_for_outbox(void) {
+    app_ready(NULL);
+    CHECK(dict_find(shim_last_outbox(), MESSAGE_KEY_REFRESH));
+
+    shim_dict_begin();
+    shim_dict_add_int(MESSAGE_KEY_SUCCESS, 1);
+    shim_deliver();
+    CHECK(s_diagnostics_pending);
+    CHECK(dict_find(shim_last_outbox(), MESSAGE_KEY_REFRESH));
+
+    shim_outbox_complete(true);
+    CHECK(!s_diagnostics_pending);
+    CHECK(dict_find(shim_last_outbox(), MESSAGE_KEY_DIAGNOSTICS));
+    shim_outbox_complete(true);
+
+    /* A rejected request frees the outbox just the same. */
+    app_ready(NULL);
+    shim_deliver();
+    CHECK(s_diagnostics_pending);
+    shim_outbox_complete(false);
+    CHECK(!s_diagnostics_pending);
+    CHECK(dict_find(shim_last_outbox(), MESSAGE_KEY_DIAGNOSTICS));
+    shim_outbox_complete(true);
+}
+
+static void test_diagnostics_wait_for_outbox(void) {
+    shim_persist_clear();
+    StudySummary q;
+    fill_summary(&q, 10);
+    save_summary(&q);
+    run_app(check_diagnostics_wait_for_outbox);
+}
+
+// --------------------------------------------------------------------------
+// Main
+// --------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    setenv("TZ", "UTC", 1);
+    tzset();
+    shim_set_time(kStartTime);
+
+    test_forecast_head_wraps();
+    test_age_summary_across_wrap();
+    test_decode_appends_after_aging();
+    test_decode_appends_to_expired_forecast();
+    test_decode_truncates_at_capacity();
+    test_malformed_chunk_leaves_forecast();
+#if defined(PBL_ROUND)
+    test_round_half_width_table();
+#endif
+    test_summary_round_trip();
+    test_short_read_leaves_summary();
+    test_histogram_capture_matches_render();
+    test_histogram_not_captured_while_covered();
+    test_timeout_keeps_saved_summary();
+    test_timeout_without_summary();
+    test_diagnostics_wait_for_outbox();
+
+    printf("%s: %d checks, %d failed\n", argv[0], s_checks, s_failures);
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,496 @@
+/* Refresh benchmark for the phone side of the app.
+ *
+ * Loads src/pkjs/index.js in Node, with stand-ins for PebbleKit JS: the
+ * Pebble object, localStorage, the pebble-clay and message_keys modules, and
+ * an XMLHttpRequest that is answered by fake WaniKani and timeline servers.
+ * For summaries with forecasts of several sizes, it runs the refresh that
+ * follows a first launch, and the one that follows a second launch with
+ * nothing changed, and reports for each how it ended, the requests
+ * made and the bytes they carried, how many of them were retries, the
+ * AppMessages sent to the watch and their dictionary bytes, and the time
+ * taken.
+ *
+ * Each forecast size runs in a process of its own, so that every run starts
+ * from an empty localStorage.  Run it from the top of the tree with
+ *
+ *     node test/pkjs/refresh-bench.js [--option value ...]
+ *
+ * after `npm install`, or with NODE_PATH set to a directory that holds
+ * underscore.  The options are those of OPTIONS below, in dashed form, such
+ * as --http-latency 200 or --server-errors 0.1.  Failures are injected at
+ * random, from a generator seeded by --seed, so a run can be repeated.  Set
+ * VERBOSE=1 to see the app's console output.
+ */
+
+'use strict';
+
+var childProcess = require('child_process');
+var Module = require('module');
+var path = require('path');
+
+var ROOT = path.join(__dirname, '..', '..');
+var digest = require(path.join(ROOT, 'src', 'pkjs', 'digest.js'));
+var FORECAST_CHUNK = 128;      // aplite's chunk size, the smallest.
+var ASSIGNMENT_COUNT = 1200;
+var ASSIGNMENT_PAGE_SIZE = 500;
+
+/* The settings, and their defaults.  The rates are the fractions of
+ * requests or messages that fail in each way. */
+var OPTIONS = {
+    entries: '0,1,24,120,240,480', // the forecast sizes to run.
+    httpLatency: 50,               // ms for each HTTP request.
+    messageLatency: 20,            // ms for the watch to answer a message.
+    serverErrors: 0,               // rate of 503 responses.
+    rateLimits: 0,                 // rate of 429 responses from WaniKani.
+    rateLimitReset: 1,             // seconds to the RateLimit-Reset of a 429.
+    networkErrors: 0,              // rate of requests that fail to connect.
+    nacks: 0,                      // rate of messages that the watch NACKs.
+    seed: 1
+};
+
+function parseOptions(argv) {
+    var options = Object.assign({}, OPTIONS);
+    for (var k = 0; k < argv.length; ++k) {
+        var match = /^--([a-z-]+)$/.exec(argv[k]);
+        if (!match || match[1] === 'run') {
+            k += match ? 1 : 0;
+            continue;
+        }
+        var name = match[1].replace(/-([a-z])/g, function (_m, c) { return c.toUpperCase(); });
+        if (!has(OPTIONS, name) || k + 1 >= argv.length) {
+            console.error('Unknown option or missing value: ' + argv[k]);
+            process.exit(2);
+        }
+        options[name] = typeof OPTIONS[name] === 'number' ? Number(argv[++k]) : argv[++k];
+    }
+    return options;
+}
+
+var options = parseOptions(process.argv.slice(2));
+
+/* A small seeded generator (mulberry32), so that the same options inject
+ * the same failures. */
+function makeRandom(seed) {
+    var state = seed >>> 0;
+    return function () {
+        state = (state + 0x6d2b79f5) >>> 0;
+        var t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+var random;
+
+// ---------------------------------------------------------------------------
+// Stand-ins for PebbleKit JS
+// ---------------------------------------------------------------------------
+
+var stats,
+    requested;
+
+function resetStats() {
+    stats = {
+        result: 'lost',
+        wanikaniRequests: 0,
+        wanikaniBytes: 0,
+        timelineRequests: 0,
+        timelineBytes: 0,
+        retries: 0,
+        faults: 0,
+        messages: 0,
+        nacks: 0,
+        messageBytes: 0
+    };
+    requested = {};
+}
+
+/* A request for the same method and URL as an earlier one of the same
+ * refresh is a retry. */
+function countRequest(method, url) {
+    var key = method + ' ' + url;
+    if (requested[key]) {
+        stats.retries += 1;
+    }
+    requested[key] = true;
+}
+
+/* The size of a message as an AppMessage dictionary: a one byte header,
+ * and a seven byte header for each tuple plus its value. */
+function dictionarySize(message) {
+    var size = 1;
+    Object.keys(message).forEach(function (key) {
+        var value = message[key];
+        size += 7;
+        if (Array.isArray(value)) {
+            size += value.length;
+        } else if (typeof value === 'string') {
+            size += value.length + 1;
+        } else {
+            size += 4;
+        }
+    });
+    return size;
+}
+
+var messageKeys = {};
+require(path.join(ROOT, 'package.json')).pebble.messageKeys.forEach(function (key, index) {
+    messageKeys[key] = 10000 + index;
+});
+
+function has(object, key) {
+    return Object.prototype.hasOwnProperty.call(object, key);
+}
+
+function installPebble() {
+    var listeners = {};
+    var storage = {};
+
+    global.window = global;
+    global.localStorage = {
+        getItem: function (key) {
+            return Object.prototype.hasOwnProperty.call(storage, key) ? storage[key] : null;
+        },
+        setItem: function (key, value) {
+            storage[key] = String(value);
+        },
+        removeItem: function (key) {
+            delete storage[key];
+        }
+    };
+
+    global.Pebble = {
+        addEventListener: function (type, listener) {
+            (listeners[type] = listeners[type] || []).push(listener);
+        },
+        emit: function (type, event) {
+            (listeners[type] || []).forEach(function (listener) {
+                listener(event || {});
+            });
+        },
+        sendAppMessage: function (message, onSuccess, onFailure) {
+            var nack = random() < options.nacks;
+            stats.messages += 1;
+            stats.messageBytes += dictionarySize(message);
+            var isError = has(message, 'ERROR') || has(message, String(messageKeys.ERROR));
+            if (isError) {
+                stats.result = 'error';
+            }
+            if (nack) {
+                stats.nacks += 1;
+            }
+            setTimeout(function () {
+                if (nack) {
+                    if (onFailure) {
+                        onFailure({}, { message: 'APP_MSG_BUSY' });
+                    }
+                } else {
+                    if (has(message, 'SUCCESS') && stats.result === 'lost') {
+                        stats.result = 'ok';
+                    }
+                    if (onSuccess) {
+                        onSuccess({});
+                    }
+                }
+            }, options.messageLatency);
+        },
+        getActiveWatchInfo: function () {
+            return { model: 'pebble_time_round_black_20mm', platform: 'chalk' };
+        },
+        getTimelineToken: function (onSuccess, _onFailure) {
+            setTimeout(function () {
+                onSuccess('timeline-token');
+            }, options.messageLatency);
+        },
+        openURL: function () {}
+    };
+
+
+    var FakeClay = function () {};
+    FakeClay.prototype = {
+        generateUrl: function () {
+            return 'data:text/html,';
+        },
+        getSettings: function (response) {
+            global.localStorage.setItem('clay-settings', response);
+            return JSON.parse(response);
+        }
+    };
+
+    var load = Module._load;
+    Module._load = function (request) {
+        if (request === 'pebble-clay') {
+            return FakeClay;
+        }
+        if (request === 'message_keys') {
+            return messageKeys;
+        }
+        return load.apply(this, arguments);
+    };
+}
+
+// ---------------------------------------------------------------------------
+// Fake servers
+// ---------------------------------------------------------------------------
+
+var MSEC_PER_HOUR = 60 * 60 * 1000;
+
+function etagOf(text) {
+    return '"' + digest(text) + '"';
+}
+
+function subjectIds(first, count) {
+    var ids = [];
+    for (var k = 0; k < count; ++k) {
+        ids.push(first + k);
+    }
+    return ids;
+}
+
+/* The summary has reviews available now, and then the given number of
+ * forecast entries an hour apart.  The times are fixed for the run, so that
+ * the second refresh finds the summary unchanged. */
+function makeSummary(entries, nowHour) {
+    var reviews = [];
+    for (var k = 0; k <= entries; ++k) {
+        reviews.push({
+            available_at: new Date((nowHour + k) * MSEC_PER_HOUR).toISOString(),
+            subject_ids: subjectIds(1000 * k, k === 0 ? 42 : 1 + (k * 37) % 23)
+        });
+    }
+    return {
+        lessons: [{ available_at: new Date(nowHour * MSEC_PER_HOUR).toISOString(), subject_ids: subjectIds(1, 15) }],
+        reviews: reviews
+    };
+}
+
+function makeAssignments(url) {
+    var updatedAfter = /updated_after=([^&]+)/.exec(url),
+        after = /page_after_id=(\d+)/.exec(url),
+        first = after ? parseInt(after[1], 10) + 1 : 1,
+        data = [];
+    if (!updatedAfter) {
+        for (var id = first; id < first + ASSIGNMENT_PAGE_SIZE && id <= ASSIGNMENT_COUNT; ++id) {
+            data.push({
+                id: id,
+                data_updated_at: '2026-01-01T00:00:00.000000Z',
+                data: { subject_id: id, srs_stage: 1 + id % 9, hidden: false }
+            });
+        }
+    }
+    var last = data.length ? data[data.length - 1].id : 0;
+    return {
+        data: data,
+        pages: {
+            next_url: last && last < ASSIGNMENT_COUNT ?
+                'https://api.wanikani.com/v2/assignments?page_after_id=' + last : null
+        }
+    };
+}
+
+function wanikaniResponse(url, headers, server) {
+    var endpoint = url.replace('https://api.wanikani.com/v2/', ''),
+        data;
+    if (endpoint === 'user') {
+        data = { data: { username: 'bench', level: 12 } };
+    } else if (endpoint === 'summary') {
+        data = { data: server.summary };
+    } else if (endpoint.indexOf('assignments') === 0) {
+        return { status: 200, body: JSON.stringify(makeAssignments(url)) };
+    } else if (endpoint.indexOf('subjects') === 0) {
+        data = { data: subjectIds(1, 30).map(function (id) { return { id: id }; }) };
+    } else {
+        return { status: 404, body: JSON.stringify({ error: 'Not found', code: 404 }) };
+    }
+    var body = JSON.stringify(data),
+        etag = etagOf(body);
+    if (headers['If-None-Match'] === etag) {
+        return { status: 304, body: '', headers: { 'ETag': etag } };
+    }
+    return { status: 200, body: body, headers: { 'ETag': etag } };
+}
+
+/* Decide whether a request fails, and if so, how: it does not connect, the
+ * server fails, or WaniKani limits the rate until a little later. */
+function injectFault(wanikani) {
+    var roll = random();
+    if (roll < options.networkErrors) {
+        return { networkError: true, body: '' };
+    }
+    roll -= options.networkErrors;
+    if (roll < options.serverErrors) {
+        return { status: 503, body: JSON.stringify({ error: 'Service Unavailable', code: 503 }) };
+    }
+    roll -= options.serverErrors;
+    if (wanikani && roll < options.rateLimits) {
+        return {
+            status: 429,
+            body: JSON.stringify({ error: 'Rate limit exceeded', code: 429 }),
+            headers: {
+                'RateLimit-Reset': String(Math.ceil(Date.now() / 1000) + options.rateLimitReset)
+            }
+        };
+    }
+    return null;
+}
+
+function installServers(server) {
+    var FakeXMLHttpRequest = function () {
+        this.requestHeaders = {};
+        this.responseHeaders = {};
+        this.status = 0;
+        this.statusText = '';
+        this.responseText = '';
+    };
+
+    FakeXMLHttpRequest.prototype = {
+        open: function (method, url) {
+            this.method = method;
+            this.url = url;
+        },
+        setRequestHeader: function (name, value) {
+            this.requestHeaders[name] = value;
+        },
+        getResponseHeader: function (name) {
+            return this.responseHeaders[name] || null;
+        },
+        send: function (body) {
+            var xhr = this,
+                wanikani = xhr.url.indexOf('https://api.wanikani.com/') === 0,
+                response = injectFault(wanikani);
+            countRequest(xhr.method, xhr.url);
+            if (response) {
+                stats.faults += 1;
+            } else if (wanikani) {
+                response = wanikaniResponse(xhr.url, xhr.requestHeaders, server);
+            } else {
+                response = { status: 200, body: '' };
+            }
+            if (wanikani) {
+                stats.wanikaniRequests += 1;
+                stats.wanikaniBytes += response.body ? response.body.length : 0;
+            } else {
+                stats.timelineRequests += 1;
+                stats.timelineBytes += body ? body.length : 0;
+            }
+            setTimeout(function () {
+                if (response.networkError) {
+                    xhr.onerror.call(xhr);
+                    return;
+                }
+                xhr.status = response.status;
+                xhr.statusText = response.status === 200 ? 'OK' : String(response.status);
+                xhr.responseText = response.body;
+                xhr.responseHeaders = response.headers || {};
+                xhr.onload.call(xhr);
+            }, options.httpLatency);
+        }
+    };
+
+    global.XMLHttpRequest = FakeXMLHttpRequest;
+}
+
+// ---------------------------------------------------------------------------
+// Runs
+// ---------------------------------------------------------------------------
+
+/* Launch the app and have the watch ask for a refresh, and report once there
+ * is nothing left to do.  The result of a refresh is 'ok' if the watch
+ * received a summary, 'error' if it was sent an error, and 'lost' if it was
+ * sent neither. */
+function runRefreshes(entries) {
+    random = makeRandom(options.seed * 7919 + entries);
+    var nowHour = Math.floor(Date.now() / MSEC_PER_HOUR),
+        server = { summary: makeSummary(entries, nowHour) },
+        results = [],
+        labels = ['first', 'second'],
+        started;
+
+    if (!process.env.VERBOSE) {
+        console.log = console.warn = console.error = function () {};
+    }
+    installPebble();
+    installServers(server);
+    global.localStorage.setItem('clay-settings', JSON.stringify({
+        API_TOKEN: 'bench-token',
+        SYNC_ASSIGNMENTS: true
+    }));
+    require(path.join(ROOT, 'src', 'pkjs', 'index.js'));
+
+    function launch() {
+        resetStats();
+        started = Date.now();
+        Pebble.emit('ready', { type: 'ready' });
+        Pebble.emit('appmessage', { payload: { REFRESH: 1, FORECAST_CHUNK: FORECAST_CHUNK } });
+    }
+
+    process.on('beforeExit', function () {
+        if (results.length === labels.length) {
+            return;
+        }
+        stats.refresh = labels[results.length];
+        stats.entries = entries;
+        stats.elapsedMs = Date.now() - started;
+        results.push(stats);
+        if (results.length < labels.length) {
+            launch();
+        } else {
+            process.stdout.write(JSON.stringify(results) + '\n');
+        }
+    });
+
+    launch();
+}
+
+function pad(value, width) {
+    var text = String(value);
+    while (text.length < width) {
+        text = ' ' + text;
+    }
+    return text;
+}
+
+function main() {
+    var columns = [
+        ['entries', 'entries', 7],
+        ['refresh', 'refresh', 7],
+        ['result', 'result', 6],
+        ['wk req', 'wanikaniRequests', 6],
+        ['wk bytes', 'wanikaniBytes', 9],
+        ['pin req', 'timelineRequests', 7],
+        ['pin bytes', 'timelineBytes', 9],
+        ['faults', 'faults', 6],
+        ['retries', 'retries', 7],
+        ['msgs', 'messages', 5],
+        ['nacks', 'nacks', 5],
+        ['msg bytes', 'messageBytes', 9],
+        ['ms', 'elapsedMs', 6]
+    ];
+    console.log(Object.keys(OPTIONS).map(function (name) {
+        return name + ' ' + options[name];
+    }).join(', '));
+    console.log(columns.map(function (c) { return pad(c[0], c[2]); }).join(' '));
+
+    String(options.entries).split(',').map(Number).forEach(function (entries) {
+        var args = [__filename, '--run', String(entries)].concat(process.argv.slice(2));
+        var run = childProcess.spawnSync(process.execPath, args, {
+            encoding: 'utf8',
+            stdio: ['ignore', 'pipe', 'inherit']
+        });
+        if (run.status !== 0) {
+            console.error('The run with ' + entries + ' entries failed.');
+            process.exit(1);
+        }
+        JSON.parse(run.stdout).forEach(function (result) {
+            console.log(columns.map(function (c) { return pad(result[c[1]], c[2]); }).join(' '));
+        });
+    });
+}
+
+var run = process.argv.indexOf('--run');
+if (run >= 0) {
+    runRefreshes(parseInt(process.argv[run + 1], 10));
+} else {
+    main();
+}